@@ -16,11 +16,19 @@ void CmdRescan::execute()
 
     std::cout << msg_plswait << std::endl; // needs a 'endl' or 'flush' here, imo 'endl' looks nicer regarding cursor visibility
 
-    // clear database, but not the configuration (SearchPathGens, root path, name filters, etc.)
-    this->ptr_media_model->clear();
-
-    // rescan filesystem
-    this->ptr_media_model->iterateFilesystem();
+    // 'rescan full' rebuilds the database from scratch
+    if (QString::compare(this->m_args, "full", Qt::CaseInsensitive) == 0)
+    {
+        // clears the database after a running background scan stopped,
+        // but not the configuration (SearchPathGens, root path, name filters, etc.)
+        this->ptr_media_model->iterateFilesystem();
+    }
+
+    // only read new and changed directories
+    else
+    {
+        this->ptr_media_model->rescan();
+    }
 
     // \033[1A move cursor one line up
     // \033[nD move cursor n columns to the left
@@ -3,7 +3,8 @@
 
 #include <Sys/command.hpp>
 
-// rebuild the whole library from scratch
+// update the library, only new and changed directories are read again
+// 'rescan full' rebuilds the whole library from scratch, use it after editing tags
 // at the moment I don't know how to efficiently watch a directory tree for changes
 // with like ~30.000+ files in it (yes, there are people which have such an amount of songs :P )
 // at this time, this needs to be invoked manually by command :(
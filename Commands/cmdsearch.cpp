@@ -18,41 +18,52 @@ CmdSearch::~CmdSearch()
     this->cmdModule.clear();
 }
 
-void CmdSearch::execute()
+// number of ranked matches which are printed before all other matches
+static const int BestMatchCount = 10;
+
+static void printMedia(const MediaLibraryModel::Media *media)
 {
-    MediaLibraryModel::MediaType type = this->mediaTypeFilter(this->m_args, this->cmdAudio, this->cmdVideo, this->cmdModule);
+    if (!media->fileformat.isEmpty())
+        std::cout << "\033[1;38;2;0;97;167m[" << media->fileformat.toUtf8().constData() << "]\033[0m ";
 
-    QList<MediaLibraryModel::Media*> search_results = this->ptr_media_model->findMultiple(this->m_args, type);
+    if (!(media->tags.album.isEmpty() && // if all 3 fields are empty, print just the relative filename
+        media->tags.artist.isEmpty() &&  // otherwise print tags
+        media->tags.title.isEmpty()))
+    {
+        std::cout << "\033[3m" << qUtf8Printable(media->tags.artist) << "\033[0m " <<
+                     "\033[1m" << qUtf8Printable(media->tags.title) << "\033[0m " <<
+                     "\033[4m" << qUtf8Printable(media->tags.album) << "\033[0m" << std::endl;
+    }
 
-    if (search_results.isEmpty())
+    else
     {
-        search_results.clear();
+        std::cout << qUtf8Printable(media->searchPaths.at(0)) << std::endl;
+    }
+}
 
+void CmdSearch::execute()
+{
+    MediaLibraryModel::MediaType type = this->mediaTypeFilter(this->m_args, this->cmdAudio, this->cmdVideo, this->cmdModule);
+
+    // the best matches first, the same ones the play commands would pick
+    // the library is searched once, all results are returned together with the ranked ones
+    QList<MediaLibraryModel::Media*> search_results;
+    const QList<MediaLibraryModel::Media*> best = this->ptr_media_model->findBest(this->m_args, type, BestMatchCount, &search_results);
+    if (best.isEmpty())
+    {
         std::cout << "Nothing found.\n" << std::endl;
         return;
     }
 
+    for (const MediaLibraryModel::Media *media : best)
+        printMedia(media);
+
+    // all other results in library order, [best] is short enough for a linear lookup
     for (MediaLibraryModel::Media *media : search_results)
     {
-        if (!media->fileformat.isEmpty())
-            std::cout << "\033[1;38;2;0;97;167m[" << media->fileformat.toUtf8().constData() << "]\033[0m ";
-
-        if (!(media->tags.album.isEmpty() && // if all 3 fields are empty, print just the relative filename
-            media->tags.artist.isEmpty() &&  // otherwise print tags
-            media->tags.title.isEmpty()))
-        {
-            std::cout << "\033[3m" << qUtf8Printable(media->tags.artist) << "\033[0m " <<
-                         "\033[1m" << qUtf8Printable(media->tags.title) << "\033[0m " <<
-                         "\033[4m" << qUtf8Printable(media->tags.album) << "\033[0m" << std::endl;
-        }
-
-        else
-        {
-            std::cout << qUtf8Printable(media->searchPaths.at(0)) << std::endl;
-        }
+        if (!best.contains(media))
+            printMedia(media);
     }
 
     std::endl(std::cout);
-
-    search_results.clear();
 }
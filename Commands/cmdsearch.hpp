@@ -3,8 +3,8 @@
 
 #include <Sys/command.hpp>
 
-// search library for something, this command invokes MediaLibraryModel::findMultiple() method
-// and prints the results on screen
+// search library for something, prints the best matches (MediaLibraryModel::findBest())
+// followed by all other results on screen
 
 class CmdSearch : public Command
 {
@@ -4,6 +4,8 @@
 
 #include <QDir>
 
+#include <Sys/mediacache.hpp>
+
 // cout -> name filters
 std::ostream &operator<<(std::ostream &os, QStringList m)
 {
@@ -29,9 +31,28 @@ void CmdStatistics::execute()
                  "      # of Video files:            " << this->ptr_media_model->count(MediaLibraryModel::Video) << "\n"
                  "      # of Module Tracker files:   " << this->ptr_media_model->count(MediaLibraryModel::ModuleTracker) << "\n"
                  "\n"
-                 "      Total # of media files:      " << this->ptr_media_model->count() << "\n"
+                 "      Total # of media files:      " << this->ptr_media_model->count() << "\n";
+
+    // the library is still being scanned in the background
+    if (this->ptr_media_model->isScanning())
+    {
+        if (this->ptr_media_model->scanTotal() == 0)
+            std::cout << "      Scanning:                    reading directories...\n";
+        else std::cout << "      Scanning:                    " << this->ptr_media_model->scanProgress()
+                       << " of " << this->ptr_media_model->scanTotal() << " files\n";
+    }
+
+    // lazy tags, media which are only searchable by their path yet
+    const int untagged = this->ptr_media_model->untaggedCount();
+    if (untagged > 0)
+        std::cout << "      Reading tags:                " << untagged << " files left\n";
+
+    // audio properties, media which can't be filtered by duration yet
+    const int unprobed = this->ptr_media_model->unprobedCount();
+    if (unprobed > 0)
+        std::cout << "      Reading audio properties:    " << unprobed << " files left\n";
 
-                 "\n\n"
+    std::cout << "\n\n"
 
                  "   \033[1m\033[3mDatabase Configuration\033[0m\n\n"
 
@@ -42,6 +63,22 @@ void CmdStatistics::execute()
                  "      Module Tracker types:  " << this->ptr_media_model->nameFilters(MediaLibraryModel::ModuleTracker) << "\n"
 
               << std::endl;
+
+    // files which slowed down the tag reading, quarantined files are not read again until they change
+    const QList<MediaCache::TagsReadRecord> slowest = MediaCache::i()->slowestTagsReads(5);
+    const int quarantined = MediaCache::i()->quarantinedCount();
+    if (!slowest.isEmpty() || quarantined > 0)
+    {
+        std::cout << "\n   \033[1m\033[3mSlowest Tag Reads\033[0m\n\n";
+
+        for (const MediaCache::TagsReadRecord &record : slowest)
+        {
+            std::cout << "      " << record.msecs << " ms" << (record.failed ? " (failed)" : "")
+                      << "   " << qUtf8Printable(record.path) << "\n";
+        }
+
+        std::cout << "\n      Quarantined files:     " << quarantined << "\n" << std::endl;
+    }
 }
 
 std::string CmdStatistics::transformPath(QString path)
@@ -29,6 +29,7 @@ LIBS += -ltag \
 SOURCES += main.cpp \
     Utils/contrib/SingleApplication/singleapplication.cpp \
     Utils/filesystemmodel.cpp \
+    Utils/paralleldirwalker.cpp \
     applicationmanager.cpp \
     musicconsole.cpp \
     Utils/medialibrarymodel.cpp \
@@ -38,6 +39,9 @@ SOURCES += main.cpp \
     SearchPathGens/unicodewhitespacefixer.cpp \
     SearchPathGens/universaljapanesekanalookup.cpp \
     Utils/searchkeys.cpp \
+    Utils/wildcardmatcher.cpp \
+    Utils/trigramindex.cpp \
+    Utils/xxhash64.cpp \
     configmanager.cpp \
     Sys/command.cpp \
     Commands/cmdaudio.cpp \
@@ -57,12 +61,16 @@ SOURCES += main.cpp \
     Sys/playlistparser.cpp \
     Sys/historymanager.cpp \
     SearchPathGens/unicodelatingen.cpp \
-    Sys/mediacache.cpp
+    Sys/mediacache.cpp \
+    Sys/librarywatcher.cpp \
+    Sys/libraryscanner.cpp \
+    Sys/tagsloader.cpp
 
 # Headers
 HEADERS += \
     Utils/contrib/SingleApplication/singleapplication.h \
     Utils/filesystemmodel.hpp \
+    Utils/paralleldirwalker.hpp \
     applicationmanager.hpp \
     musicconsole.hpp \
     Utils/medialibrarymodel.hpp \
@@ -72,6 +80,9 @@ HEADERS += \
     SearchPathGens/unicodewhitespacefixer.hpp \
     SearchPathGens/universaljapanesekanalookup.hpp \
     Utils/searchkeys.hpp \
+    Utils/wildcardmatcher.hpp \
+    Utils/trigramindex.hpp \
+    Utils/xxhash64.hpp \
     configmanager.hpp \
     Sys/command.hpp \
     Commands/cmdaudio.hpp \
@@ -92,6 +103,9 @@ HEADERS += \
     Sys/historymanager.hpp \
     SearchPathGens/unicodelatingen.hpp \
     Sys/mediacache.hpp \
+    Sys/librarywatcher.hpp \
+    Sys/libraryscanner.hpp \
+    Sys/tagsloader.hpp \
     Utils/range_based_for_loop.hpp
 
 ##[Local] ─ ignore this; for taglib experiments
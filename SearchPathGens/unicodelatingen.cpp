@@ -62,6 +62,16 @@ QStringList UnicodeLatinGen::processString(const QString &str) const
     return list;
 }
 
+QString UnicodeLatinGen::fold(const QString &str) const
+{
+    QString latin1 = str;
+
+    for (QChar &c : latin1)
+        c = this->toLatin1(c);
+
+    return latin1;
+}
+
 bool UnicodeLatinGen::isLatinChar(const QChar &c)
 {
     for (UnicodeLatinGen::iterator i = UnicodeLatinGen::d_latinmap.begin();
@@ -43,6 +43,10 @@ class UnicodeLatinGen : public SearchPathGen
 {
 public:
     QStringList processString(const QString &) const;
+    bool isPathSegmentSafe() const { return true; }
+
+    // everything is folded to Basic-Latin1
+    QString fold(const QString &) const;
 
 private:
     static const QMap<QChar, QChar> d_latinmap;
@@ -7,6 +7,8 @@ class UnicodeWhitespaceFixer : public SearchPathGen
 {
 public:
     QStringList processString(const QString&) const;
+    bool isPathSegmentSafe() const { return true; }
+    QString fold(const QString &str) const { return this->processString(str).at(0); }
 
     // skips \n char
     void processTextFileData(QString *) const;
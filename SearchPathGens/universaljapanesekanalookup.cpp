@@ -296,6 +296,49 @@ public:
         return _c;
     }
 
+    // the opposite of toHalfwidthKatakana(), half-width katakana with dakuten are 2 characters long
+    QString fromHalfwidthKatakana(const QString &str) const
+    {
+        QString data;
+        data.reserve(str.size());
+
+        for (int i = 0; i < str.size(); )
+        {
+            QChar _c;
+            int length = 0;
+
+            // not in the half-width katakana block, nothing to look up
+            const ushort u = str.at(i).unicode();
+            if (u < 0xFF65 || u > 0xFF9F)
+            {
+                data.append(str.at(i));
+                i++;
+                continue;
+            }
+
+            // prefer the longest match, the dakuten belongs to the kana before it
+            for (const auto &it : this->halfwidth_katakana_map)
+            {
+                if (it.second.size() > length && str.midRef(i, it.second.size()) == it.second)
+                {
+                    _c = it.first;
+                    length = it.second.size();
+                }
+            }
+
+            if (length == 0)
+            {
+                _c = str.at(i);
+                length = 1;
+            }
+
+            data.append(_c);
+            i += length;
+        }
+
+        return data;
+    }
+
 private:
     static const std::map<QChar, QChar> kana_map;
     static const std::map<QChar, QString> halfwidth_katakana_map;
@@ -444,3 +487,21 @@ QStringList UniversalJapaneseKanaLookup::processString(const QString &str) const
 
     return searchMap;
 }
+
+QString UniversalJapaneseKanaLookup::fold(const QString &str) const
+{
+    QString data = str;
+
+    // fix (broken?) dakuten coding
+    static const KanaFix kanaFix;
+    kanaFix.fixChar(data);
+
+    // half-width katakana -> katakana -> hiragana
+    static const KanaCompare kanaCompare;
+    data = kanaCompare.fromHalfwidthKatakana(data);
+
+    for (QChar &c : data)
+        c = kanaCompare.toHiragana(c);
+
+    return data;
+}
@@ -7,6 +7,12 @@ class UniversalJapaneseKanaLookup : public SearchPathGen
 {
 public:
     QStringList processString(const QString &) const;
+
+    // the dakuten fix looks at the next character too, but never across a '/'
+    bool isPathSegmentSafe() const { return true; }
+
+    // everything is folded to hiragana, including half-width katakana
+    QString fold(const QString &) const;
 };
 
 #endif // UNIVERSALJAPANESEKANALOOKUP_HPP
@@ -0,0 +1,27 @@
+#include "libraryscanner.hpp"
+
+LibraryScanner::LibraryScanner(MediaLibraryModel *media_model, Mode mode, QObject *parent)
+    : QThread(parent),
+      ptr_media_model(media_model),
+      m_mode(mode)
+{
+}
+
+LibraryScanner::~LibraryScanner()
+{
+    this->wait();
+}
+
+void LibraryScanner::run()
+{
+    if (this->m_mode == FullScan)
+    {
+        this->ptr_media_model->scanFilesystem();
+    }
+
+    else
+    {
+        // compare the whole tree, only new and changed directories are read from disk
+        this->ptr_media_model->updateDirectories(QStringList() << QString());
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LIBRARYSCANNER_HPP
+#define LIBRARYSCANNER_HPP
+
+/**
+ *
+ * LibraryScanner
+ *
+ * Scans the filesystem in the background, the prompt is available right away.
+ *
+ *   Validate   the library was restored from the snapshot, which may be
+ *              outdated; only new and changed directories are read,
+ *              the files of changed directories are compared with the
+ *              MediaCache to find files which were modified in place
+ *
+ *   FullScan   there is no snapshot, the library is built from scratch;
+ *              the media objects are published in batches and can be
+ *              used while the scan is still running
+ *
+ * All changes are queued in the model and applied before the next command
+ * is executed [MediaLibraryModel::applyPendingUpdates()].
+ *
+ */
+
+#include <QThread>
+
+#include <Utils/medialibrarymodel.hpp>
+
+class LibraryScanner : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        Validate,
+        FullScan
+    };
+
+    explicit LibraryScanner(MediaLibraryModel *media_model, Mode mode, QObject *parent = 0);
+    ~LibraryScanner();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    MediaLibraryModel *ptr_media_model;
+    Mode m_mode;
+};
+
+#endif // LIBRARYSCANNER_HPP
@@ -0,0 +1,220 @@
+#include "librarywatcher.hpp"
+
+#include <QFile>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_LINUX
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+static const uint32_t WatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                  IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+#endif
+
+static const int PollInterval = 250; // ms, how often the stop request is checked
+static const int QuietPeriod = 1000; // ms without events before the changes are applied
+static const int MaxDelay = 10000;   // ms, apply the changes anyway if events never stop
+
+LibraryWatcher::LibraryWatcher(MediaLibraryModel *media_model, QObject *parent)
+    : QThread(parent),
+      ptr_media_model(media_model)
+{
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+    this->stop();
+
+    this->m_watches.clear();
+    this->m_watchedDirs.clear();
+    this->m_changedDirs.clear();
+    this->m_modifiedFiles.clear();
+}
+
+bool LibraryWatcher::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void LibraryWatcher::stop()
+{
+    this->requestInterruption();
+    this->wait();
+}
+
+void LibraryWatcher::run()
+{
+#ifdef Q_OS_LINUX
+    this->m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->m_fd == -1)
+        return;
+
+    QElapsedTimer first_event, last_event;
+    bool pending = false;
+
+    while (!this->isInterruptionRequested())
+    {
+        // a scan found new directories (or the library wasn't scanned yet when the watcher started)
+        if (this->m_watchedRevision != this->ptr_media_model->directoriesRevision())
+            this->syncWatches();
+
+        struct pollfd pfd;
+        pfd.fd = this->m_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        if (::poll(&pfd, 1, PollInterval) > 0 && this->readEvents())
+        {
+            if (!pending)
+                first_event.start();
+            last_event.start();
+            pending = true;
+        }
+
+        // coalesce bursts of events into a single update
+        if (pending && (last_event.elapsed() >= QuietPeriod || first_event.elapsed() >= MaxDelay))
+        {
+            this->flush();
+            pending = false;
+        }
+    }
+
+    // closing the descriptor removes all watches
+    ::close(this->m_fd);
+    this->m_fd = -1;
+    this->m_watches.clear();
+    this->m_watchedDirs.clear();
+#endif
+}
+
+void LibraryWatcher::syncWatches()
+{
+#ifdef Q_OS_LINUX
+    // read the revision first, a scan committing in between is picked up by the next check
+    this->m_watchedRevision = this->ptr_media_model->directoriesRevision();
+
+    const QString root = this->ptr_media_model->rootPath();
+    const QStringList dirs = this->ptr_media_model->directories();
+    const QSet<QString> known = QSet<QString>::fromList(dirs);
+
+    for (const QString &dir : dirs)
+    {
+        if (this->m_watchedDirs.contains(dir))
+            continue;
+
+        const QByteArray path = QFile::encodeName(dir.isEmpty() ? root : root + '/' + dir);
+
+        // fails if the directory is already gone or the watch limit is reached
+        int wd = ::inotify_add_watch(this->m_fd, path.constData(), WatchMask);
+        if (wd == -1)
+            continue;
+
+        this->m_watches.insert(wd, dir);
+        this->m_watchedDirs.insert(dir, wd);
+    }
+
+    for (QHash<QString, int>::iterator it = this->m_watchedDirs.begin(); it != this->m_watchedDirs.end(); )
+    {
+        if (known.contains(it.key()))
+        {
+            ++it;
+            continue;
+        }
+
+        (void) ::inotify_rm_watch(this->m_fd, it.value());
+        this->m_watches.remove(it.value());
+        it = this->m_watchedDirs.erase(it);
+    }
+#endif
+}
+
+bool LibraryWatcher::readEvents()
+{
+    bool changed = false;
+
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buf[16384];
+    ssize_t nread;
+
+    while ((nread = ::read(this->m_fd, buf, sizeof(buf))) > 0)
+    {
+        for (char *pos = buf; pos < buf + nread; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            // the kernel dropped events, the whole tree must be compared
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                this->m_changedDirs.insert(QString());
+                changed = true;
+                continue;
+            }
+
+            QHash<int, QString>::const_iterator watch = this->m_watches.constFind(event->wd);
+            if (watch == this->m_watches.constEnd())
+                continue;
+
+            const QString dir = watch.value();
+
+            // the watch was removed by the kernel
+            if (event->mask & IN_IGNORED)
+            {
+                this->m_watchedDirs.remove(dir);
+                this->m_watches.remove(event->wd);
+                continue;
+            }
+
+            // the directory itself was deleted or moved away
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // a moved directory keeps its watch, but the path is wrong now
+                if (event->mask & IN_MOVE_SELF)
+                    (void) ::inotify_rm_watch(this->m_fd, event->wd);
+
+                this->m_changedDirs.insert(dir);
+                changed = true;
+                continue;
+            }
+
+            // hidden entries are never part of the library
+            if (event->len == 0 || event->name[0] == '.')
+                continue;
+
+            // entries were added, removed or renamed
+            if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+            {
+                this->m_changedDirs.insert(dir);
+                changed = true;
+            }
+
+            // a file was written, tags may have changed
+            else if ((event->mask & IN_CLOSE_WRITE) && !(event->mask & IN_ISDIR))
+            {
+                const QString name = QFile::decodeName(QByteArray(event->name));
+                this->m_modifiedFiles.insert(dir.isEmpty() ? name : dir + '/' + name);
+                changed = true;
+            }
+        }
+    }
+#endif
+
+    return changed;
+}
+
+void LibraryWatcher::flush()
+{
+    const QStringList dirs = this->m_changedDirs.toList();
+    const QStringList files = this->m_modifiedFiles.toList();
+
+    this->m_changedDirs.clear();
+    this->m_modifiedFiles.clear();
+
+    // reads the changed directories and queues the changes in the model
+    this->ptr_media_model->updateDirectories(dirs, files);
+}
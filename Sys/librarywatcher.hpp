@@ -0,0 +1,75 @@
+#ifndef LIBRARYWATCHER_HPP
+#define LIBRARYWATCHER_HPP
+
+/**
+ *
+ * LibraryWatcher
+ *
+ * Keeps the media library up to date while Music Console is running,
+ * the 'rescan' command is only required if the watcher is disabled.
+ *
+ *    ~ Linux only, uses inotify
+ *
+ * Every directory of the library gets an inotify watch, the watches follow
+ * every scan which changes the directory list (startup scan, 'rescan' and
+ * the watcher itself). Events are collected until the filesystem is quiet
+ * for a moment (copying a whole album results in a single update), than
+ * only the directories which reported changes are read again
+ * [MediaLibraryModel::updateDirectories()].
+ *
+ * The changes are queued in the model and applied by the console thread
+ * before the next command is executed, media objects are never changed
+ * or deleted while a command is using them.
+ *
+ * NOTE: every directory requires one watch, huge libraries may exceed the
+ *       limit in /proc/sys/fs/inotify/max_user_watches; directories
+ *       without a watch are only updated by the 'rescan' command
+ *
+ */
+
+#include <QThread>
+#include <QHash>
+#include <QSet>
+
+#include <Utils/medialibrarymodel.hpp>
+
+class LibraryWatcher : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryWatcher(MediaLibraryModel *media_model, QObject *parent = 0);
+    ~LibraryWatcher();
+
+    // checks if the watcher is available on the current platform
+    static bool isSupported();
+
+    // stops the watcher and waits until the thread is finished
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    // adds watches for new directories and removes the ones of vanished directories
+    void syncWatches();
+
+    // reads all available events, returns true if something in the library may have changed
+    bool readEvents();
+
+    // passes the collected changes to the model
+    void flush();
+
+    MediaLibraryModel *ptr_media_model;
+
+    int m_fd = -1;
+    QHash<int, QString> m_watches;     // watch descriptor -> directory relative to the root path
+    QHash<QString, int> m_watchedDirs; // directory relative to the root path -> watch descriptor
+
+    int m_watchedRevision = -1; // directory revision of the model the watches belong to
+
+    QSet<QString> m_changedDirs;
+    QSet<QString> m_modifiedFiles;
+};
+
+#endif // LIBRARYWATCHER_HPP
@@ -1,84 +1,61 @@
 #include "mediacache.hpp"
 
+#include <Utils/xxhash64.hpp>
+
 #include <QByteArray>
 #include <QDataStream>
-#include <QFileInfo>
-#include <QDateTime>
-#include <QCryptographicHash>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 MediaCache *mediaCache = nullptr;
 
-const quint32 MediaCache::crc32_table[256] =
-{
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
-    0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
-    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
-    0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
-    0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
-    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
-    0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
-    0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
-    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
-    0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
-    0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
-    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
-    0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
-    0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
-    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
-    0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
-    0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
-    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
-    0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
-    0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
-    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
-    0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
-    0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
-    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
-    0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
-    0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
-    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
-    0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
-    0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
-    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
-    0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
-    0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
-    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
-};
+// cache file header
+// NOTE: increase the version whenever the layout of the entries changes
+static const quint32 CacheMagic = 0x4D434344; // "MCCD"
+static const quint32 CacheVersion = 3;
+
+static const int HeaderSize = 8;                      // magic, version
+
+// quarantine file header
+static const quint32 QuarantineMagic = 0x4D435151; // "MCQQ"
+static const quint32 QuarantineVersion = 1;
+
+static const qint64 TagsReadBudget = 3000; // ms, files which take longer are quarantined
+static const int SlowestCount = 10;        // number of slow reads which are remembered
+static const int EntryHeaderSize = 4 + 8 + 8 + 8 + 8; // payload size, key, inode, size, mtime
+
+static QByteArray fileHeader()
+{
+    uchar header[HeaderSize];
+    qToLittleEndian<quint32>(CacheMagic, header);
+    qToLittleEndian<quint32>(CacheVersion, header + 4);
+    return QByteArray(reinterpret_cast<const char*>(header), HeaderSize);
+}
+
+template<typename T>
+static QByteArray entryHeader(int size, quint64 key, const T &stat)
+{
+    uchar header[EntryHeaderSize];
+    qToLittleEndian<quint32>(size, header);
+    qToLittleEndian<quint64>(key, header + 4);
+    qToLittleEndian<quint64>(stat.inode, header + 12);
+    qToLittleEndian<quint64>(stat.size, header + 20);
+    qToLittleEndian<qint64>(stat.mtime, header + 28);
+    return QByteArray(reinterpret_cast<const char*>(header), EntryHeaderSize);
+}
 
 MediaCache::MediaCache(const QString &cacheRoot)
 {
     this->m_dir = cacheRoot + QDir::separator();
+    this->m_file = this->m_dir + "media.db";
+    this->m_quarantineFile = this->m_dir + "quarantine";
 
     QDir dir(this->m_dir);
     if (dir.mkpath(dir.absolutePath()))
@@ -88,9 +65,19 @@ MediaCache::MediaCache(const QString &cacheRoot)
 
 MediaCache::~MediaCache()
 {
+    // get rid of the outdated entries if they take up a good part of the file
+    if (this->m_outdated > 0 && this->m_outdated >= this->m_index.size() / 4)
+        (void) this->compact();
+
+    this->close();
+
+    {
+        QMutexLocker lock(&this->m_quarantineMutex);
+        this->saveQuarantine();
+    }
+
     this->ptr_media = nullptr;
-    this->m_mediaHash.clear();
-    this->m_dirHashed.clear();
+    this->m_mediaHash = 0;
 }
 
 void MediaCache::createInstance(const QString &cacheRoot)
@@ -104,22 +91,35 @@ MediaCache *MediaCache::i()
     return mediaCache;
 }
 
-void MediaCache::setMedia(MediaLibraryModel::Media *media)
+void MediaCache::setMedia(MediaLibraryModel::Media *media, bool afterMiss)
 {
     if (!media)
         return;
 
     this->ptr_media = media;
 
-    this->m_mediaHash.clear();
-    this->m_dirHashed.clear();
+    // media path as key in the cache, the file identity decides if the entry is still valid
+    this->m_mediaHash = this->getHash(this->ptr_media->path);
 
-    // media path as filename in the cache
-    this->m_mediaHash = this->getHash(this->ptr_media);
+    // the lookup of this file just missed, the entry is created now with the stat taken
+    // before the tags were read (a change in between is detected next time)
+    // the stat is never kept any longer, lazy tags may be read minutes later
+    bool missed;
+    {
+        QMutexLocker lock(&this->m_mutex);
+        missed = afterMiss && this->m_missedStat.valid && this->m_missedHash == this->m_mediaHash;
+        if (missed)
+            this->m_mediaStat = this->m_missedStat;
+
+        this->m_missedStat = FileStat();
+    }
 
-    // media directory (path) in the cache
-    for (const QString &dir : this->ptr_media->path.split(QDir::separator(), QString::SkipEmptyParts))
-        this->m_dirHashed.append(this->getDirHash(dir) + QDir::separator());
+    if (!missed)
+        this->m_mediaStat = this->getFileStat(this->ptr_media->path);
+
+    // the cache file is read on first use only, a snapshot startup doesn't need it at all
+    QMutexLocker lock(&this->m_mutex);
+    this->load();
 }
 
 bool MediaCache::hasMedia() const
@@ -128,50 +128,82 @@ bool MediaCache::hasMedia() const
     if (!this->m_cacheReadable || !this->ptr_media)
         return false;
 
-    // checking for media is simple as checking for file existence here ;)
-    if (QFile::exists(this->m_dir + this->m_dirHashed + this->m_mediaHash))
+    // the file can't be compared, read it again (it is most likely gone anyway)
+    if (!this->m_mediaStat.valid)
+        return false;
+
+    QMutexLocker lock(&this->m_mutex);
+    QHash<quint64, Entry>::const_iterator entry = this->m_index.constFind(this->m_mediaHash);
+    if (entry != this->m_index.constEnd() && entry->stat == this->m_mediaStat)
         return true;
 
+    // keep the stat for the createMedia() which follows a miss
+    this->m_missedHash = this->m_mediaHash;
+    this->m_missedStat = this->m_mediaStat;
     return false;
 }
 
-bool MediaCache::createMedia() const
+bool MediaCache::createMedia()
 {
     // do nothing if the cache dir is not readable or no media object is set
     if (!this->m_cacheReadable || !this->ptr_media)
         return false;
 
-    // create cache file and store the cached information into it
-    // the file is in "human-unreadable" (serialized) form
-    QDir dir(this->m_dir + this->m_dirHashed);
-    if (dir.mkpath(dir.absolutePath()))
-    {
-        QFile file(this->m_dir + this->m_dirHashed + this->m_mediaHash);
-        if (file.open(QIODevice::WriteOnly))
-        {
-            QDataStream data(&file);
+    // an entry without a file identity would never be valid
+    if (!this->m_mediaStat.valid)
+        return false;
 
-            int SearthPathGenCount = this->ptr_media->searchPaths.size();
+    // serialize the cached information
+    // the data is in "human-unreadable" (serialized) form
+    QByteArray payload;
+    {
+        QDataStream data(&payload, QIODevice::WriteOnly);
 
-            // write tags
-            data << this->ptr_media->tags.artist
-                 << this->ptr_media->tags.album
-                 << this->ptr_media->tags.title
-                 << this->ptr_media->tags.genre;
+        int SearthPathGenCount = this->ptr_media->searchPaths.size();
 
-            // write searth path gen strings
-            data << SearthPathGenCount;
+        // write tags
+        data << this->ptr_media->tags.artist
+             << this->ptr_media->tags.album
+             << this->ptr_media->tags.title
+             << this->ptr_media->tags.genre;
 
-            for (int i = 0; i < SearthPathGenCount; i++)
-                data << this->ptr_media->searchPaths.at(i);
+        // write searth path gen strings
+        data << SearthPathGenCount;
 
-            // close file
-            file.close();
-            return true;
-        }
+        for (int i = 0; i < SearthPathGenCount; i++)
+            data << this->ptr_media->searchPaths.at(i);
+
+        // write audio properties
+        data << this->ptr_media->properties.probed
+             << this->ptr_media->properties.duration
+             << this->ptr_media->properties.bitrate
+             << this->ptr_media->properties.sampleRate
+             << this->ptr_media->properties.channels;
     }
 
-    return false;
+    QMutexLocker lock(&this->m_mutex);
+
+    if (!this->m_db.isOpen())
+        return false;
+
+    // append the new entry to the end of the file, the file is unbuffered so it can be read back right away
+    const qint64 pos = this->m_db.pos();
+    const QByteArray entryData = entryHeader(payload.size(), this->m_mediaHash, this->m_mediaStat) + payload;
+    if (this->m_db.write(entryData) != entryData.size())
+        return false;
+
+    // the previous entry of the same file is outdated now
+    if (this->m_index.contains(this->m_mediaHash))
+        this->m_outdated++;
+
+    Entry entry;
+    entry.offset = pos + EntryHeaderSize;
+    entry.size = payload.size();
+    entry.stat = this->m_mediaStat;
+
+    this->m_index.insert(this->m_mediaHash, entry);
+
+    return true;
 }
 
 void MediaCache::getCachedData() const
@@ -180,68 +212,389 @@ void MediaCache::getCachedData() const
     if (!this->m_cacheReadable || !this->ptr_media)
         return;
 
-    // read the data from the serialized cache file
-    QFile file(this->m_dir + this->m_dirHashed + this->m_mediaHash);
-    if (file.open(QIODevice::ReadOnly))
+    QByteArray payload;
     {
-        QDataStream data(&file);
+        QMutexLocker lock(&this->m_mutex);
+        payload = this->payload(this->m_mediaHash);
+    }
 
-        int SearthPathGenCount = 0;
+    if (payload.isEmpty())
+        return;
 
-        // read tags
-        data >> this->ptr_media->tags.artist
-             >> this->ptr_media->tags.album
-             >> this->ptr_media->tags.title
-             >> this->ptr_media->tags.genre;
+    // read the data from the serialized cache entry
+    QDataStream data(payload);
 
-        // get amount of searth path gen strings
-        data >> SearthPathGenCount;
+    int SearthPathGenCount = 0;
 
-        // read searth path gen strings
-        for (int i = 0; i < SearthPathGenCount; i++)
+    // read tags
+    data >> this->ptr_media->tags.artist
+         >> this->ptr_media->tags.album
+         >> this->ptr_media->tags.title
+         >> this->ptr_media->tags.genre;
+
+    // get amount of searth path gen strings
+    data >> SearthPathGenCount;
+
+    // read searth path gen strings
+    for (int i = 0; i < SearthPathGenCount && data.status() == QDataStream::Ok; i++)
+    {
+        QString str;
+        data >> str;
+        this->ptr_media->searchPaths.append(str);
+        str.clear();
+    }
+
+    // read audio properties
+    data >> this->ptr_media->properties.probed
+         >> this->ptr_media->properties.duration
+         >> this->ptr_media->properties.bitrate
+         >> this->ptr_media->properties.sampleRate
+         >> this->ptr_media->properties.channels;
+}
+
+bool MediaCache::compact()
+{
+    QMutexLocker lock(&this->m_mutex);
+
+    if (!this->m_loaded || !this->m_db.isOpen() || this->m_outdated == 0)
+        return false;
+
+    // write the newest entry of every file into a new cache file
+    // the old file is only replaced if everything went well
+    QSaveFile file(this->m_file);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    (void) file.write(fileHeader());
+
+    for (QHash<quint64, Entry>::const_iterator it = this->m_index.constBegin(); it != this->m_index.constEnd(); ++it)
+    {
+        const QByteArray payload = this->payload(it.key());
+        (void) file.write(entryHeader(payload.size(), it.key(), it.value().stat));
+        (void) file.write(payload);
+    }
+
+    if (!file.commit())
+        return false;
+
+    // read the new file on next use
+    this->close();
+    return true;
+}
+
+bool MediaCache::isQuarantined(const MediaLibraryModel::Media *media)
+{
+    if (!this->m_cacheReadable || !media)
+        return false;
+
+    const quint64 key = this->getHash(media->path);
+
+    {
+        QMutexLocker lock(&this->m_quarantineMutex);
+        this->loadQuarantine();
+
+        if (!this->m_quarantine.contains(key))
+            return false;
+    }
+
+    // the file changed, give it another try
+    const FileStat stat = this->getFileStat(media->path);
+
+    QMutexLocker lock(&this->m_quarantineMutex);
+    QHash<quint64, QuarantineEntry>::iterator entry = this->m_quarantine.find(key);
+    if (entry == this->m_quarantine.end())
+        return false;
+
+    if (stat.valid && entry->stat == stat)
+        return true;
+
+    this->m_quarantine.erase(entry);
+    this->m_quarantineModified = true;
+    return false;
+}
+
+void MediaCache::recordTagsRead(const MediaLibraryModel::Media *media, qint64 msecs, bool failed)
+{
+    if (!media)
+        return;
+
+    TagsReadRecord record;
+    record.path = media->path;
+    record.msecs = msecs;
+    record.failed = failed;
+
+    const bool quarantine = failed || msecs > TagsReadBudget;
+    const FileStat stat = quarantine ? this->getFileStat(media->path) : FileStat();
+
+    QMutexLocker lock(&this->m_quarantineMutex);
+
+    // keep the slowest reads sorted, most reads are fast and end here
+    if (this->m_slowest.size() < SlowestCount || msecs > this->m_slowest.last().msecs)
+    {
+        int i = 0;
+        while (i < this->m_slowest.size() && this->m_slowest.at(i).msecs >= msecs)
+            i++;
+
+        this->m_slowest.insert(i, record);
+        if (this->m_slowest.size() > SlowestCount)
+            this->m_slowest.removeLast();
+    }
+
+    // a file which can't be stat'ed can't be recognized later on
+    if (quarantine && stat.valid)
+    {
+        this->loadQuarantine();
+
+        QuarantineEntry entry;
+        entry.stat = stat;
+        entry.record = record;
+
+        this->m_quarantine.insert(this->getHash(media->path), entry);
+        this->m_quarantineModified = true;
+    }
+}
+
+QList<MediaCache::TagsReadRecord> MediaCache::slowestTagsReads(int count) const
+{
+    QMutexLocker lock(&this->m_quarantineMutex);
+    this->loadQuarantine();
+
+    QList<TagsReadRecord> records = this->m_slowest;
+    for (const QuarantineEntry &entry : this->m_quarantine)
+    {
+        bool known = false;
+        for (const TagsReadRecord &record : records)
+        {
+            if (record.path == entry.record.path)
+                known = true;
+        }
+
+        if (!known)
+            records.append(entry.record);
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const TagsReadRecord &r1, const TagsReadRecord &r2) {
+        return r1.msecs > r2.msecs;
+    });
+
+    return records.mid(0, count);
+}
+
+int MediaCache::quarantinedCount() const
+{
+    QMutexLocker lock(&this->m_quarantineMutex);
+    this->loadQuarantine();
+    return this->m_quarantine.size();
+}
+
+void MediaCache::loadQuarantine() const
+{
+    if (this->m_quarantineLoaded)
+        return;
+
+    this->m_quarantineLoaded = true;
+
+    QFile file(this->m_quarantineFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream data(&file);
+    data.setVersion(QDataStream::Qt_5_0);
+    data.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0, version = 0, count = 0;
+    data >> magic >> version >> count;
+    if (magic != QuarantineMagic || version != QuarantineVersion)
+        return;
+
+    for (quint32 i = 0; i < count && data.status() == QDataStream::Ok; i++)
+    {
+        quint64 key;
+        QuarantineEntry entry;
+
+        data >> key >> entry.stat.inode >> entry.stat.size >> entry.stat.mtime
+             >> entry.record.path >> entry.record.msecs >> entry.record.failed;
+
+        if (data.status() == QDataStream::Ok)
+            this->m_quarantine.insert(key, entry);
+    }
+}
+
+void MediaCache::saveQuarantine()
+{
+    // deleted files will never be read again
+    for (QHash<quint64, QuarantineEntry>::iterator it = this->m_quarantine.begin(); it != this->m_quarantine.end(); )
+    {
+        if (!QFile::exists(it->record.path))
         {
-            QString str;
-            data >> str;
-            this->ptr_media->searchPaths.append(str);
-            str.clear();
+            it = this->m_quarantine.erase(it);
+            this->m_quarantineModified = true;
         }
+        else ++it;
     }
+
+    if (!this->m_quarantineModified || !this->m_cacheReadable)
+        return;
+
+    QSaveFile file(this->m_quarantineFile);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream data(&file);
+    data.setVersion(QDataStream::Qt_5_0);
+    data.setByteOrder(QDataStream::LittleEndian);
+
+    data << QuarantineMagic << QuarantineVersion << quint32(this->m_quarantine.size());
+    for (QHash<quint64, QuarantineEntry>::const_iterator it = this->m_quarantine.constBegin(); it != this->m_quarantine.constEnd(); ++it)
+    {
+        data << it.key() << it->stat.inode << it->stat.size << it->stat.mtime
+             << it->record.path << it->record.msecs << it->record.failed;
+    }
+
+    if (data.status() == QDataStream::Ok && file.commit())
+        this->m_quarantineModified = false;
 }
 
-QString MediaCache::getHash(const MediaLibraryModel::Media *media)
+void MediaCache::load()
 {
-    return QString(QCryptographicHash::hash((
+    if (this->m_loaded || !this->m_cacheReadable)
+        return;
+
+    this->m_loaded = true;
+
+    this->m_db.setFileName(this->m_file);
+    if (!this->m_db.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+    {
+        this->m_cacheReadable = false;
+        return;
+    }
+
+    if (this->m_db.size() >= HeaderSize)
+    {
+        this->m_mapSize = this->m_db.size();
+        this->m_map = this->m_db.map(0, this->m_mapSize);
+    }
+
+    // new, unreadable or incompatible cache file, start from scratch
+    if (!this->m_map ||
+        qFromLittleEndian<quint32>(this->m_map) != CacheMagic ||
+        qFromLittleEndian<quint32>(this->m_map + 4) != CacheVersion)
+    {
+        if (this->m_map)
+            (void) this->m_db.unmap(this->m_map);
+        this->m_map = nullptr;
+        this->m_mapSize = 0;
+
+        (void) this->m_db.resize(0);
+        (void) this->m_db.seek(0);
+        (void) this->m_db.write(fileHeader());
+        return;
+    }
+
+    // index all entries in one sequential pass, the payloads stay in the mapping
+    qint64 pos = HeaderSize;
+    while (pos + EntryHeaderSize <= this->m_mapSize)
+    {
+        const uchar *header = this->m_map + pos;
+        const quint32 size = qFromLittleEndian<quint32>(header);
 
-        // media path
-        media->path +
+        // half written entry, the program was killed while writing
+        if (pos + EntryHeaderSize + size > this->m_mapSize)
+            break;
 
-        // media type
-        QString::number(media->type) +
+        const quint64 key = qFromLittleEndian<quint64>(header + 4);
 
-        // modification date
-        QFileInfo(media->path).lastModified()
-            .toString("Day(dd):Month(MM):Year(yyyy)::"
-                      "Hour(hh):Minute(mm):Second(ss):Millisecond(zzz)")
+        Entry entry;
+        entry.offset = pos + EntryHeaderSize;
+        entry.size = size;
+        entry.stat.inode = qFromLittleEndian<quint64>(header + 12);
+        entry.stat.size = qFromLittleEndian<quint64>(header + 20);
+        entry.stat.mtime = qFromLittleEndian<qint64>(header + 28);
 
+        // later entries replace earlier ones of the same file
+        if (this->m_index.contains(key))
+            this->m_outdated++;
+        this->m_index.insert(key, entry);
 
-        ).toUtf8(),
+        pos += EntryHeaderSize + size;
+    }
+
+    // cut off the broken entry, new entries are appended after the last valid one
+    if (pos < this->m_db.size())
+        (void) this->m_db.resize(pos);
 
-        // hash algorithm
-        QCryptographicHash::Sha1).toHex());
+    (void) this->m_db.seek(pos);
 }
 
-QString MediaCache::getDirHash(const QString &dirName)
+void MediaCache::close()
 {
-    quint32 crc32 = 0xffffffff;
+    if (this->m_map)
+        (void) this->m_db.unmap(this->m_map);
+    this->m_map = nullptr;
+    this->m_mapSize = 0;
 
-    QByteArray data = dirName.toUtf8();
-    int data_size = data.size();
+    this->m_db.close();
 
-    for (int i = 0; i < data_size; i++)
-        crc32 = (crc32 >> 8) ^ crc32_table[(crc32 & 0xff) ^ (data.at(i) & 0xff)];
-    crc32 ^= 0xffffffff;
+    this->m_index.clear();
+    this->m_outdated = 0;
+    this->m_loaded = false;
+}
 
-    data.clear();
+QByteArray MediaCache::payload(quint64 key) const
+{
+    QHash<quint64, Entry>::const_iterator entry = this->m_index.constFind(key);
+    if (entry == this->m_index.constEnd())
+        return QByteArray();
+
+    // no copy, the mapping stays valid until the cache is closed
+    if (entry->offset + entry->size <= this->m_mapSize)
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(this->m_map + entry->offset), entry->size);
+
+    // appended in this session, behind the end of the mapping
+    QByteArray data(entry->size, Qt::Uninitialized);
+    if (::pread(this->m_db.handle(), data.data(), entry->size, entry->offset) != entry->size)
+        return QByteArray();
+    return data;
+}
+
+bool MediaCache::FileStat::operator== (const FileStat &other) const
+{
+    return this->inode == other.inode &&
+           this->size == other.size &&
+           this->mtime == other.mtime;
+}
+
+quint64 MediaCache::getHash(const QString &path)
+{
+    const QByteArray data = path.toUtf8();
+    return xxh64(reinterpret_cast<const uchar*>(data.constData()), data.size());
+}
+
+MediaCache::FileStat MediaCache::getFileStat(const QString &path)
+{
+    FileStat stat;
+    const QByteArray file = QFile::encodeName(path);
+
+    // a file which can't be stat'ed gets an invalid identity, it is never looked up or stored
+#ifdef STATX_BASIC_STATS
+    struct statx stx;
+    if (::statx(AT_FDCWD, file.constData(), 0, STATX_INO | STATX_SIZE | STATX_MTIME, &stx) == 0)
+    {
+        stat.inode = stx.stx_ino;
+        stat.size = stx.stx_size;
+        stat.mtime = qint64(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+        stat.valid = true;
+    }
+#else
+    struct ::stat st;
+    if (::stat(file.constData(), &st) == 0)
+    {
+        stat.inode = st.st_ino;
+        stat.size = st.st_size;
+        stat.mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        stat.valid = true;
+    }
+#endif
 
-    return QString::number(crc32, 16).rightJustified(8, '0', false);
+    return stat;
 }
@@ -4,32 +4,60 @@
 /**
  *
  * MediaCache
- * -- ${CONFIGROOT}/cache/[insert strange filenames here]/...
+ * -- ${CONFIGROOT}/cache/media.db
+ * -- ${CONFIGROOT}/cache/quarantine
  *
- * The hash files stores the cached information,
+ * The cache stores the tags and the SearchPathGen strings of every media,
  * to speed up the NEXT program startup significantly!
  *
- * Because reading serialized files is faster than re-reading the
+ * Because reading serialized data is faster than re-reading the
  * tags using taglib and re-generating all SearthPathGen strings.
  *
  * Optimally detect changes to files and recreate the
- * cached file as needed.
+ * cached data as needed.
  *
- * Directory structure:
- *  cache/{CRC32}-hashed dirnames/{SHA-1}-hashed relative media path = filename
  *
+ * All entries are packed into a single file, new entries are appended
+ * to the end of it. The file is mapped into memory and indexed with one
+ * sequential pass on first use, than every lookup is a hash table lookup.
  *
- *   Contents of the hash file       DATA IS SERIALIZED using QDataStream
- *  ˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙
- *    [MediaTags struct]
- *      artist, album, title
+ * Entries are keyed by a 64-bit xxHash of the media path. Every entry
+ * stores the inode, size and modification time (ns) of the file, which are
+ * compared with a single statx() call; a changed file gets a new entry,
+ * the old one is outdated from now on. If too much outdated entries piled
+ * up, the file is compacted on exit.
  *
- *    SearchPathGens generated strings
+ *
+ *   Contents of the cache file      DATA IS SERIALIZED using QDataStream
+ *  ˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙˙
+ *    header     magic, version
+ *
+ *    entry      payload size, key (path hash), inode, size, mtime
+ *               [MediaTags struct]
+ *                 artist, album, title, genre
+ *               SearchPathGens generated strings
+ *               [MediaProperties struct]
+ *                 probed, duration, bitrate, sample rate, channels
+ *
+ *    entry      ...
+ *
+ *
+ * Files which can't be read or take longer than a few seconds to read are
+ * quarantined, their tags are not read again until the file changes.
+ * The quarantine is kept in its own small file.
+ *
+ * NOTE: all public member functions are thread-safe, but setMedia() and the
+ *       functions which work on the set media belong together; only one
+ *       thread at a time should use them (the MediaLibraryModel takes care of that)
  *
  */
 
 #include <Utils/medialibrarymodel.hpp>
 
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
 class MediaCache
 {
 public:
@@ -37,38 +65,117 @@ public:
     static MediaCache *i();
     ~MediaCache();
 
-    void setMedia(MediaLibraryModel::Media *);
+    // the file is stat'ed here; [afterMiss]: the tags were just read because hasMedia() missed,
+    // the stat of that lookup is used if no other file was set in between
+    void setMedia(MediaLibraryModel::Media *, bool afterMiss = false);
 
     // checks if the MediaCache contains the given Media object
     bool hasMedia() const;
 
-    // creates a new cache file in the MediaCache
-    bool createMedia() const;
+    // creates a new cache entry in the MediaCache
+    bool createMedia();
 
     // stores the cached data into the Media object
     void getCachedData() const;
 
+    // rewrites the cache file without the outdated entries
+    bool compact();
+
+    struct TagsReadRecord {
+        QString path;
+        qint64 msecs = 0;
+        bool failed = false;
+    };
+
+    // thread-safe: checks if the tags of the given media shouldn't be read
+    bool isQuarantined(const MediaLibraryModel::Media *);
+
+    // thread-safe: records the duration and outcome of reading the tags of the given media,
+    // quarantines the file if the read failed or took too long
+    void recordTagsRead(const MediaLibraryModel::Media *, qint64 msecs, bool failed);
+
+    // thread-safe: the slowest tag reads of this session and the quarantined files, slowest first
+    QList<TagsReadRecord> slowestTagsReads(int count) const;
+
+    // thread-safe: number of quarantined files
+    int quarantinedCount() const;
+
 private:
     MediaCache(const QString &cacheRoot);
+
+    // maps the cache file and builds the index, done once on first use
+    void load();
+    void close();
+
     QString m_dir;
+    QString m_file;
     bool m_cacheReadable;
 
+    // identity of a file on the disk, a different value means the file has changed
+    struct FileStat {
+        quint64 inode = 0;
+        quint64 size = 0;
+        qint64 mtime = 0; // nanoseconds
+        bool valid = false; // false if the file couldn't be stat'ed, not stored in the cache
+
+        bool operator== (const FileStat &other) const;
+    };
+
     MediaLibraryModel::Media *ptr_media = nullptr;
-    QString m_mediaHash;
-    QString m_dirHashed;
+    quint64 m_mediaHash = 0;
+    FileStat m_mediaStat;
+
+    // location of the payload of an entry
+    // entries written in this session are read back from the file, the mapping doesn't cover them
+    struct Entry {
+        qint64 offset = -1; // offset of the payload in the cache file
+        int size = 0;
+        FileStat stat;
+    };
+
+    mutable QMutex m_mutex;
+    bool m_loaded = false;
+
+    QFile m_db;
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
 
-    // calculate a hash for the given media
-    // the hash is always the same for the same media,
-    // as long as the file hasn't changed on the disk
+    QHash<quint64, Entry> m_index; // key -> newest entry
+    int m_outdated = 0;            // number of entries which were replaced by a newer one
+
+    // stat of the last lookup which missed, dropped by the next setMedia()
+    mutable quint64 m_missedHash = 0;
+    mutable FileStat m_missedStat;
+
+    // calculate a hash for the given media path (64-bit xxHash)
+    // the hash is always the same for the same path
+    static quint64 getHash(const QString &path);
+
+    // inode, size and modification time of the file
     //
     // a file change can mean, that the user has updated the tags
-    // in this case the MediaCache creates a new cache file with the new tags
-    static QString getHash(const MediaLibraryModel::Media *);
+    // in this case the MediaCache creates a new cache entry with the new tags
+    static FileStat getFileStat(const QString &path);
+
+    // payload of the given key, requires the mutex to be locked
+    QByteArray payload(quint64 key) const;
+
+    struct QuarantineEntry {
+        FileStat stat;
+        TagsReadRecord record;
+    };
+
+    // loaded on first use (the statistics may be the first user), written on exit if changed
+    // requires the quarantine mutex to be locked
+    void loadQuarantine() const;
+    void saveQuarantine();
 
-    // CRC-32 hash for dir names
-    // always the same output for the same input
-    static const quint32 crc32_table[256];
-    static QString getDirHash(const QString &dirName);
+    QString m_quarantineFile;
+    mutable QMutex m_quarantineMutex;
+    mutable bool m_quarantineLoaded = false;
+    bool m_quarantineModified = false;
+    mutable QHash<quint64, QuarantineEntry> m_quarantine; // key -> entry
+    QList<TagsReadRecord> m_slowest;              // slowest reads of this session, slowest first
 };
 
 #endif // MEDIACACHE_HPP
@@ -0,0 +1,32 @@
+#include "tagsloader.hpp"
+
+static const int BatchSize = 50;     // media per queued update
+static const int PollInterval = 250; // ms, how often new media are looked for when idle
+
+TagsLoader::TagsLoader(MediaLibraryModel *media_model, QObject *parent)
+    : QThread(parent),
+      ptr_media_model(media_model)
+{
+}
+
+TagsLoader::~TagsLoader()
+{
+    this->stop();
+}
+
+void TagsLoader::stop()
+{
+    this->requestInterruption();
+    this->wait();
+}
+
+void TagsLoader::run()
+{
+    while (!this->isInterruptionRequested())
+    {
+        // new media are added by every scan, keep looking for them
+        if (!this->ptr_media_model->loadTags(BatchSize) &&
+            !this->ptr_media_model->loadProperties(BatchSize))
+            QThread::msleep(PollInterval);
+    }
+}
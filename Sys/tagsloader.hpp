@@ -0,0 +1,40 @@
+#ifndef TAGSLOADER_HPP
+#define TAGSLOADER_HPP
+
+/**
+ *
+ * TagsLoader
+ *
+ * Reads the tags of new media in the background if lazy tags are enabled,
+ * neither the startup nor a scan waits for taglib. Also reads the audio
+ * properties (duration, ...) if they are enabled, after all tags are read.
+ *
+ * The media are searchable by their path right away, the tags are queued
+ * in the model and become searchable before the next command is executed
+ * [MediaLibraryModel::applyPendingUpdates()].
+ *
+ */
+
+#include <QThread>
+
+#include <Utils/medialibrarymodel.hpp>
+
+class TagsLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit TagsLoader(MediaLibraryModel *media_model, QObject *parent = 0);
+    ~TagsLoader();
+
+    // stops the loader and waits until the thread is finished
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    MediaLibraryModel *ptr_media_model;
+};
+
+#endif // TAGSLOADER_HPP
@@ -114,6 +114,31 @@ inline FileSystemModel *FileSystemModel::clone(const QString &toDirectory) const
     return model;
 }
 
+void FileSystemModel::setWalkerBackend(WalkerBackend backend)
+{
+    this->m_walkerBackend = backend;
+}
+
+FileSystemModel::WalkerBackend FileSystemModel::walkerBackend() const
+{
+    return this->m_walkerBackend;
+}
+
+void FileSystemModel::setDirectoryState(const DirectoryState &state)
+{
+    this->m_previousDirState = state;
+}
+
+const FileSystemModel::DirectoryState &FileSystemModel::directoryState() const
+{
+    return this->m_dirState;
+}
+
+const QStringList &FileSystemModel::changedDirectories() const
+{
+    return this->m_changedDirs;
+}
+
 QStringList FileSystemModel::currentDirectories(ListingType type) const
 {
     return this->entryList(type, this->qDirDirs());
@@ -132,6 +157,17 @@ void FileSystemModel::iterateFilesystem(ListingType type, bool sort)
     // create a new filelist object
     this->m_filelist = new QStringList();
 
+    // use the multi-threaded walker if requested and available
+    if (this->m_walkerBackend == ParallelWalker && ParallelDirWalker::isSupported())
+    {
+        this->iterateFilesystemParallel(type);
+
+        // sort the list case-sensitive unicode (icu) alphabetically using std::stable_sort()
+        // the parallel walker returns the files in random order
+        if (sort) std::stable_sort(this->m_filelist->begin(), this->m_filelist->end(), this->sort);
+        return;
+    }
+
     // define a QDirIterator pointer
     QDirIterator *iterator = nullptr;
 
@@ -192,10 +228,43 @@ void FileSystemModel::iterateFilesystem(ListingType type, bool sort)
     // delete the QDirIterator
     delete iterator;
 
+    // the QDirIterator doesn't know about directory states
+    this->m_previousDirState.clear();
+
     // sort the list case-sensitive unicode (icu) alphabetically using std::stable_sort()
     if (sort) std::stable_sort(this->m_filelist->begin(), this->m_filelist->end(), this->sort);
 }
 
+void FileSystemModel::iterateFilesystemParallel(ListingType type)
+{
+    ParallelDirWalker walker(this->m_dir.absolutePath(), this->m_filters);
+    walker.setPreviousState(&this->m_previousDirState);
+    walker.walk();
+
+    // the walker returns paths relative to the root path
+    *this->m_filelist = walker.files();
+
+    this->m_dirState = walker.state();
+    this->m_changedDirs = walker.changedDirectories();
+    this->m_previousDirState.clear();
+
+    if (type == Filenames)
+    {
+        for (QString &file : *this->m_filelist)
+            file.remove(0, file.lastIndexOf('/') + 1);
+    }
+
+    else if (type != RelativePaths)
+    {
+        QString prefix = this->m_dir.absolutePath();
+        if (!prefix.endsWith('/'))
+            prefix.append('/');
+
+        for (QString &file : *this->m_filelist)
+            file.prepend(prefix);
+    }
+}
+
 QStringList *FileSystemModel::filelist() const
 {
     return this->m_filelist;
@@ -274,4 +343,8 @@ void FileSystemModel::clear()
         delete this->m_filelist;
         this->m_filelist = nullptr;
     }
+
+    // don't touch the previous directory state here, it is required by the next walk
+    this->m_dirState.clear();
+    this->m_changedDirs.clear();
 }
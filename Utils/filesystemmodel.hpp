@@ -33,6 +33,8 @@
 #include <QString>
 #include <QDir>
 
+#include "paralleldirwalker.hpp"
+
 class FileSystemModel : public QObject
 {
     Q_OBJECT
@@ -49,6 +51,64 @@ public:
         RelativePaths    // path relative to 'rootPath' including filename
     };
 
+    enum WalkerBackend {
+        QDirIteratorWalker, // single-threaded QDirIterator, works everywhere (default)
+        ParallelWalker      // multi-threaded getdents64() walker, see ParallelDirWalker
+                            // falls back to QDirIterator on non-Linux platforms
+    };
+
+    /**
+     * @brief setWalkerBackend(WalkerBackend) [void]
+     *
+     * Selects the implementation used by 'iterateFilesystem'.
+     *
+     * The ParallelWalker reads many directories at the same time and
+     * avoids a stat() for most files. Use it for large trees and
+     * high-latency network mounts.
+     *
+     * Both backends produce the same file list.
+     *
+     */
+    void setWalkerBackend(WalkerBackend);
+    WalkerBackend walkerBackend() const;
+
+    typedef ParallelDirWalker::DirectoryState DirectoryState;
+
+    /**
+     * @brief setDirectoryState(DirectoryState) [void]
+     *
+     * ParallelWalker only.
+     *
+     * Passes the directory state of a previous 'iterateFilesystem' call
+     * to the next one. Directories which didn't change since then are
+     * not read again. The file list is complete anyways.
+     *
+     */
+    void setDirectoryState(const DirectoryState &state);
+
+    /**
+     * @brief directoryState [const DirectoryState&]
+     *
+     * ParallelWalker only.
+     *
+     * Returns the mtime, inode and contents of every directory seen by
+     * the last 'iterateFilesystem' call. Empty for the QDirIterator.
+     *
+     */
+    const DirectoryState &directoryState() const;
+
+    /**
+     * @brief changedDirectories [const QStringList&]
+     *
+     * ParallelWalker only.
+     *
+     * Returns the directories which were read from disk by the last
+     * 'iterateFilesystem' call, because they are new or have changed
+     * compared to the state set by 'setDirectoryState'.
+     *
+     */
+    const QStringList &changedDirectories() const;
+
     /**
      * @brief setRootPath(rootPath) [bool]
      *
@@ -257,6 +317,15 @@ private:
 
     QStringList *m_filelist = nullptr;
 
+    WalkerBackend m_walkerBackend = QDirIteratorWalker;
+
+    DirectoryState m_previousDirState;
+    DirectoryState m_dirState;
+    QStringList m_changedDirs;
+
+    // 'iterateFilesystem' using the ParallelDirWalker
+    void iterateFilesystemParallel(ListingType);
+
 protected:
 
     QString m_rootPath;
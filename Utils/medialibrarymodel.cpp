@@ -1,15 +1,53 @@
 #include "medialibrarymodel.hpp"
 
 #include <Utils/mediatagsreader.hpp>
+#include <Utils/xxhash64.hpp>
 #include <Sys/mediacache.hpp>
 
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include <algorithm>
+#include <iterator>
+#include <climits>
 #include <chrono>
 #include <random>
 
+// number of media objects which are queued at once while scanning
+static const int ScanBatchSize = 500;
+
+// findMultiple(): lists with more media are matched by multiple threads,
+// every thread takes chunks of consecutive media and collects the matches of each chunk separately
+static const int ParallelSearchThreshold = 16384;
+static const int SearchChunkSize = 2048;
+
+// number of findMultiple() results which are kept, the least recently used are dropped first
+static const int QueryCacheSize = 32;
+
+// library snapshot header
+// NOTE: increase the version whenever the layout, the Media struct or the SearchPathGens change
+static const quint32 SnapshotMagic = 0x4D434C53; // "MCLS"
+static const quint32 SnapshotVersion = 4;
+
+// smallest possible serialized directory and media entry, the counts in the snapshot can't be larger
+// than the remaining bytes allow (empty strings and lists take 4 bytes)
+static const int SnapshotMinDirectorySize = 4 + 8 + 8 + 4 + 4;
+static const int SnapshotMinMediaSize = 4 + 4 + 1 + 1 + 4 + 4 * 4 + 1 + 4 * 4;
+
 MediaLibraryModel::MediaLibraryModel(QObject *parent)
     : FileSystemModel(parent)
 {
     // construct a media library model of the users home directory
+    // media libraries are huge and often on network mounts, walk them in parallel
+    this->setWalkerBackend(FileSystemModel::ParallelWalker);
+    this->m_queryCache.setMaxCost(QueryCacheSize);
+    this->applyDefaultNameFilters();
     this->m_dir = QDir::home();
     this->m_rootPath = this->m_dir.absolutePath();
     this->m_rootPathStrLength = this->m_rootPath.size() + 1;
@@ -28,6 +66,7 @@ MediaLibraryModel::~MediaLibraryModel()
 {
     this->m_filters.clear();
     this->m_prefixDeletionPatterns.clear();
+    this->discardPendingUpdates();
     this->clear();
 
     this->deleteSearchPathGens();
@@ -57,6 +96,7 @@ MediaLibraryModel::Media::~Media()
 {
     this->path.clear();
     this->searchPaths.clear();
+    this->foldedSearchPaths.clear();
     this->fileformat.clear();
 }
 
@@ -129,8 +169,548 @@ void MediaLibraryModel::addSearchPathGen(SearchPathGen *gen)
 
 void MediaLibraryModel::iterateFilesystem()
 {
+    // a running background scan stops at its next batch, its queued changes are discarded below
+    this->m_scanAbort.storeRelease(1);
+    QMutexLocker lock(&this->m_scanRunMutex);
+    this->m_scanAbort.storeRelease(0);
+
     this->clear();
+    this->applyDefaultNameFilters();
+
+    // build the extension -> media type lookup table from the name filters
+    this->buildMediaTypeLookup();
+
+    // walk the filesystem only once using all name filters together
+    // every file is sorted into its media type using the lookup table afterwards
+    this->FileSystemModel::setNameFilters(this->nameFilters());
+    this->FileSystemModel::setDirectoryState(this->m_dirState);
+    this->FileSystemModel::iterateFilesystem(FileSystemModel::RelativePaths, true);
+    this->commitDirectoryState(this->FileSystemModel::directoryState());
+
+    // build [Media] objects and append to list
+    this->buildMediaList(this->FileSystemModel::filelist(), &this->m_media);
+
+    // clean up
+    this->FileSystemModel::clear();
+    this->FileSystemModel::clearNameFilters();
+
+    // keep the well-known list order: all audio files first, followed by video and module tracker files
+    // the file list is already sorted alphabetically, so a stable sort by type is enough here
+    std::stable_sort(this->m_media.begin(), this->m_media.end(),
+        [](const Media *m1, const Media *m2) {
+            return m1->type < m2->type;
+        });
+
+    this->finalizeMediaList();
+
+    this->m_publishedState = this->m_dirState;
+    this->m_snapshotOutdated = true;
+    (void) this->saveSnapshot();
+
+    // queued changes of the library watcher are part of the new media list already
+    this->discardPendingUpdates();
+}
+
+void MediaLibraryModel::rescan()
+{
+    bool has_state = false;
+    {
+        QMutexLocker lock(&this->m_scanMutex);
+        has_state = !this->m_dirState.isEmpty();
+    }
+
+    // without the state of a previous scan, everything must be read again
+    if (!has_state || this->m_media.isEmpty() || !ParallelDirWalker::isSupported())
+    {
+        this->iterateFilesystem();
+        return;
+    }
+
+    // compare the whole tree, changes of the library watcher which are still queued are applied too
+    this->updateDirectories(QStringList() << QString());
+    (void) this->applyPendingUpdates();
+    (void) this->saveSnapshot();
+}
+
+void MediaLibraryModel::scanFilesystem()
+{
+    if (!ParallelDirWalker::isSupported())
+        return;
+
+    QMutexLocker lock(&this->m_scanRunMutex);
+
+    // everything is new, the media objects are queued in batches while the scan is running
+    // a full rescan in between already built the library, only the changes since then are read
+    if (this->m_dirState.isEmpty())
+        this->commitDirectoryState(DirectoryState());
+    this->scanDirectories(QStringList() << QString(), QStringList());
+}
+
+void MediaLibraryModel::updateDirectories(const QStringList &dirs, const QStringList &modified)
+{
+    if (!ParallelDirWalker::isSupported())
+        return;
+
+    QMutexLocker lock(&this->m_scanRunMutex);
+
+    // nothing to compare with, the library wasn't scanned yet
+    if (this->m_dirState.isEmpty())
+        return;
+
+    this->scanDirectories(dirs, modified);
+}
+
+void MediaLibraryModel::cancelScans()
+{
+    this->m_scansCanceled.storeRelease(1);
+}
+
+bool MediaLibraryModel::isScanning() const
+{
+    return this->m_scanning.loadAcquire() != 0;
+}
+
+int MediaLibraryModel::scanProgress() const
+{
+    return this->m_scanDone.loadAcquire();
+}
+
+int MediaLibraryModel::scanTotal() const
+{
+    return this->m_scanTotal.loadAcquire();
+}
+
+void MediaLibraryModel::setLazyTags(bool enabled)
+{
+    this->m_lazyTags = enabled;
+}
+
+bool MediaLibraryModel::lazyTags() const
+{
+    return this->m_lazyTags;
+}
+
+void MediaLibraryModel::setCanonicalSearch(bool enabled)
+{
+    this->m_canonicalSearch = enabled;
+}
+
+bool MediaLibraryModel::canonicalSearch() const
+{
+    return this->m_canonicalSearch;
+}
+
+QList<SearchPathGen*> MediaLibraryModel::folding() const
+{
+    return this->m_canonicalSearch ? this->m_searchPathGens : QList<SearchPathGen*>();
+}
+
+bool MediaLibraryModel::loadTags(int count)
+{
+    QList<Media> batch;
+
+    {
+        QMutexLocker lock(&this->m_backgroundMutex);
+        batch = this->m_untagged.mid(0, count);
+        this->m_untagged.erase(this->m_untagged.begin(), this->m_untagged.begin() + batch.size());
+    }
+
+    if (batch.isEmpty())
+        return false;
+
+    LibraryDelta delta;
+
+    for (Media &media : batch)
+    {
+        // the remaining media are read again next session
+        if (this->m_scansCanceled.loadAcquire())
+            break;
+
+        // another session or an earlier scan may have cached the tags already
+        bool cached = false;
+        {
+            QMutexLocker lock(&this->m_scanMutex);
+            MediaCache::i()->setMedia(&media);
+            if (MediaCache::i()->hasMedia())
+            {
+                media.searchPaths.clear();
+                MediaCache::i()->getCachedData();
+                cached = true;
+            }
+        }
+
+        const bool probe = this->m_audioProperties && !media.properties.probed;
+
+        // nothing new, the file just has no tags
+        if (cached && media.tags.isEmpty() && !probe)
+            continue;
+
+        // read the tags without blocking the scans, the copy isn't shared with anyone
+        if (!cached)
+        {
+            this->readTags(&media);
+            this->appendTagsSearchPath(&media);
+        }
+
+        this->foldSearchPaths(&media);
+
+        if (probe)
+            (void) MediaTagsReader::readAudioProperties(&media);
+
+        if (!cached || probe)
+        {
+            QMutexLocker lock(&this->m_scanMutex);
+            MediaCache::i()->setMedia(&media, !cached);
+            (void) MediaCache::i()->createMedia();
+        }
+
+        delta.updated.append(media);
+    }
+
+    this->queueDelta(delta);
+    return true;
+}
+
+int MediaLibraryModel::untaggedCount() const
+{
+    QMutexLocker lock(&this->m_backgroundMutex);
+    return this->m_untagged.size();
+}
+
+void MediaLibraryModel::setAudioProperties(bool enabled)
+{
+    this->m_audioProperties = enabled;
+}
+
+bool MediaLibraryModel::audioProperties() const
+{
+    return this->m_audioProperties;
+}
+
+bool MediaLibraryModel::loadProperties(int count)
+{
+    QList<Media> batch;
+
+    {
+        QMutexLocker lock(&this->m_backgroundMutex);
+        batch = this->m_unprobed.mid(0, count);
+        this->m_unprobed.erase(this->m_unprobed.begin(), this->m_unprobed.begin() + batch.size());
+    }
+
+    if (batch.isEmpty())
+        return false;
+
+    LibraryDelta delta;
+
+    for (Media &media : batch)
+    {
+        // the remaining media are read again next session
+        if (this->m_scansCanceled.loadAcquire())
+            break;
+
+        // files which can't be read are marked as probed too, they are not tried again
+        (void) MediaTagsReader::readAudioProperties(&media);
+
+        {
+            QMutexLocker lock(&this->m_scanMutex);
+            MediaCache::i()->setMedia(&media);
+            (void) MediaCache::i()->createMedia();
+        }
+
+        delta.updated.append(media);
+    }
+
+    this->queueDelta(delta);
+    return true;
+}
+
+int MediaLibraryModel::unprobedCount() const
+{
+    QMutexLocker lock(&this->m_backgroundMutex);
+    return this->m_unprobed.size();
+}
+
+bool MediaLibraryModel::applyPendingUpdates()
+{
+    QList<LibraryDelta> updates;
+
+    {
+        QMutexLocker lock(&this->m_pendingMutex);
+        updates.swap(this->m_pendingUpdates);
+    }
+
+    if (updates.isEmpty())
+        return false;
+
+    // apply in the same order as the changes were computed
+    for (LibraryDelta &delta : updates)
+    {
+        this->removeMedia(delta.removed);
+        this->insertMedia(delta.added);
+
+        // the directory state matches the media list after the last batch of a scan
+        if (!delta.state.isEmpty())
+            this->m_publishedState = delta.state;
+
+        // media which were removed in the meantime are skipped
+        QList<Media*> updated;
+        for (const Media &u : delta.updated)
+        {
+            Media *media = this->m_mediaByPath.value(u.path, nullptr);
+            if (!media)
+                continue;
+
+            media->tags = u.tags;
+            media->searchPaths = u.searchPaths;
+            media->foldedSearchPaths = u.foldedSearchPaths;
+            media->properties = u.properties;
+            updated.append(media);
+        }
+
+        // cached results may contain the old state of the updated media
+        this->updateSearchIndex(QSet<Media*>::fromList(updated), delta.added + updated);
+    }
+
+    this->m_snapshotOutdated = true;
+
+    this->createSortedMediaList();
+    return true;
+}
+
+QStringList MediaLibraryModel::directories() const
+{
+    QMutexLocker lock(&this->m_scanMutex);
+    return this->m_dirState.keys();
+}
+
+int MediaLibraryModel::directoriesRevision() const
+{
+    return this->m_dirRevision.loadAcquire();
+}
+
+void MediaLibraryModel::commitDirectoryState(const DirectoryState &state)
+{
+    QMutexLocker lock(&this->m_scanMutex);
+    this->m_dirState = state;
+
+    // the library watcher adds the watches of new directories
+    (void) this->m_dirRevision.ref();
+}
+
+bool MediaLibraryModel::scanCanceled() const
+{
+    return this->m_scansCanceled.loadAcquire() || this->m_scanAbort.loadAcquire();
+}
+
+void MediaLibraryModel::scanDirectories(const QStringList &dirs, const QStringList &modified)
+{
+    if (this->scanCanceled())
+        return;
+
+    this->m_scanDone.storeRelease(0);
+    this->m_scanTotal.storeRelease(0);
+    this->m_scanning.storeRelease(1);
+
+    // drop directories which are part of another subtree
+    QStringList scope;
+    for (const QString &dir : dirs)
+    {
+        bool covered = false;
+        for (const QString &parent : dirs)
+        {
+            if (parent != dir && this->isSubdirectory(dir, parent))
+                covered = true;
+        }
+
+        if (!covered && !scope.contains(dir))
+            scope.append(dir);
+    }
+
+    this->buildMediaTypeLookup();
+
+    // walk the subtrees, only new and changed directories are read
+    DirectoryState state;
+    QStringList changed;
+
+    if (!scope.isEmpty())
+    {
+        QList<QByteArray> startDirs;
+        for (const QString &dir : scope)
+            startDirs.append(QFile::encodeName(dir));
+
+        ParallelDirWalker walker(this->rootPath(), this->nameFilters());
+        walker.setPreviousState(&this->m_dirState);
+        walker.walk(startDirs);
+
+        state = walker.state();
+        changed = walker.changedDirectories();
+    }
+
+    QStringList added, removed;
+    QStringList candidates = modified;
+    const QSet<QString> written = QSet<QString>::fromList(modified);
+
+    // compare the contents of all new and changed directories
+    for (const QString &dir : changed)
+    {
+        const QString prefix = dir.isEmpty() ? QString() : dir + '/';
+        QSet<QString> before = QSet<QString>::fromList(this->m_dirState.value(dir).files);
+
+        for (const QString &file : state.value(dir).files)
+        {
+            if (!before.remove(file))
+                added.append(prefix + file);
+
+            // the files which stayed in a changed directory may have been modified too (tag editing
+            // while the application wasn't running), the MediaCache compares them with a single stat
+            else if (!written.contains(prefix + file))
+            {
+                Media media;
+                media.path = prefix + file;
+
+                QMutexLocker lock(&this->m_scanMutex);
+                MediaCache::i()->setMedia(&media);
+                if (!MediaCache::i()->hasMedia())
+                    candidates.append(media.path);
+            }
+        }
+
+        for (const QString &file : before)
+            removed.append(prefix + file);
+    }
+
+    // the new directory state is committed after all media objects were built
+    DirectoryState next = this->m_dirState;
+
+    // directories of the subtrees which are gone, including all of their files
+    for (DirectoryState::iterator it = next.begin(); it != next.end(); )
+    {
+        bool in_scope = false;
+        for (const QString &dir : scope)
+        {
+            if (this->isSubdirectory(it.key(), dir))
+                in_scope = true;
+        }
+
+        if (!in_scope || state.contains(it.key()))
+        {
+            ++it;
+            continue;
+        }
+
+        const QString prefix = it.key().isEmpty() ? QString() : it.key() + '/';
+        for (const QString &file : it->files)
+            removed.append(prefix + file);
+
+        it = next.erase(it);
+    }
+
+    for (DirectoryState::const_iterator it = state.constBegin(); it != state.constEnd(); ++it)
+        next.insert(it.key(), it.value());
+
+    // files which were modified in place are built again
+    // the MediaCache notices the new modification time and reads the tags again
+    // the old media object is removed together with the batch which builds the new one
+    QSet<QString> known = QSet<QString>::fromList(added);
+    QSet<QString> replaced;
+    for (const QString &file : candidates)
+    {
+        if (known.contains(file))
+            continue;
+
+        int sep = file.lastIndexOf('/');
+        const QString dir = sep == -1 ? QString() : file.left(sep);
+
+        // skip files which don't match the name filters or are already gone
+        if (next.value(dir).files.contains(file.mid(sep + 1)))
+        {
+            added.append(file);
+            known.insert(file);
+            replaced.insert(file);
+        }
+    }
+
+    if (removed.isEmpty() && added.isEmpty())
+    {
+        this->commitDirectoryState(next);
+        this->m_scanning.storeRelease(0);
+        return;
+    }
+
+    this->m_scanTotal.storeRelease(added.size());
+
+    // build the media objects in batches, every batch is usable before the scan is finished
+    // a full scan waits for this one and discards the queue, so no outdated changes are applied later
+    LibraryDelta delta;
+    delta.removed = removed;
+
+    for (int i = 0; i < added.size(); i += ScanBatchSize)
+    {
+        // stop here, the directory state stays as it is
+        // a later scan finds the same changes again, media objects which were already queued are skipped
+        // modified files which weren't built yet keep their old media object, their directory didn't change
+        if (this->scanCanceled())
+        {
+            this->queueDelta(delta);
+            this->m_scanning.storeRelease(0);
+            return;
+        }
+
+        const QStringList batch = added.mid(i, ScanBatchSize);
+        for (const QString &file : batch)
+        {
+            if (replaced.contains(file))
+                delta.removed.append(file);
+        }
+
+        this->buildMediaList(&batch, &delta.added);
+        this->m_scanDone.fetchAndAddRelease(batch.size());
+
+        if (i + ScanBatchSize < added.size())
+        {
+            this->queueDelta(delta);
+            delta = LibraryDelta();
+        }
+    }
+
+    this->commitDirectoryState(next);
+    delta.state = next;
+    this->queueDelta(delta);
+
+    this->m_scanning.storeRelease(0);
+}
+
+void MediaLibraryModel::queueDelta(const LibraryDelta &delta)
+{
+    if (delta.removed.isEmpty() && delta.added.isEmpty() && delta.state.isEmpty() && delta.updated.isEmpty())
+        return;
 
+    QMutexLocker lock(&this->m_pendingMutex);
+    this->m_pendingUpdates.append(delta);
+}
+
+void MediaLibraryModel::discardPendingUpdates()
+{
+    QMutexLocker lock(&this->m_pendingMutex);
+
+    for (LibraryDelta &delta : this->m_pendingUpdates)
+        qDeleteAll(delta.added);
+
+    this->m_pendingUpdates.clear();
+}
+
+bool MediaLibraryModel::isSubdirectory(const QString &dir, const QString &parent)
+{
+    return parent.isEmpty() || dir == parent || dir.startsWith(parent + '/');
+}
+
+void MediaLibraryModel::setSnapshotFile(const QString &file)
+{
+    this->m_snapshotFile = file;
+}
+
+void MediaLibraryModel::applyDefaultNameFilters()
+{
     // if no namefilters were set (userconfig), use some hardcoded defaults to keep the media list clean
     // don't confuse this default list with the one from ConfigManager, it just adds more security
     if (!this->m_filters.contains(Audio))
@@ -141,244 +721,542 @@ void MediaLibraryModel::iterateFilesystem()
             {"*.mp4","*.h264","*.h263","*.ts","*.m2ts","*.mov","*.ogm","*.avi","*.bk2","*.bnk","*.mkv","*.wmv","*.rv"}));
     if (!this->m_filters.contains(ModuleTracker))
         this->m_filters.insert(ModuleTracker, QStringList({"*.xm","*.it","*.mod","*.med","*.sid","*.s3m"}));
+}
 
-    this->iterateFilesystemHelper(this->m_filters[Audio], Audio);
-    this->iterateFilesystemHelper(this->m_filters[Video], Video);
-    this->iterateFilesystemHelper(this->m_filters[ModuleTracker], ModuleTracker);
+void MediaLibraryModel::buildMediaTypeLookup()
+{
+    this->m_typeLookup.clear();
+    this->m_typeWildcards.clear();
 
-    this->finalizeMediaList();
+    static const QRegExp wildcardChars("[\\*\\?\\[\\.]");
+
+    // the first media type wins if the same extension is set for multiple types
+    for (MediaType type : {Audio, Video, ModuleTracker})
+    {
+        for (const QString &filter : this->m_filters.value(type))
+        {
+            QString ext = filter.mid(2).toLower();
+
+            // simple '*.ext' filter, the lookup is case-insensitive like the QDir name filters
+            if (filter.startsWith("*.") && !ext.isEmpty() && !ext.contains(wildcardChars))
+            {
+                if (!this->m_typeLookup.contains(ext))
+                    this->m_typeLookup.insert(ext, type);
+            }
+
+            // everything else is matched against the filename, slow but rarely used
+            else {
+                this->m_typeWildcards.append(qMakePair(QRegExp(filter, Qt::CaseInsensitive, QRegExp::Wildcard), type));
+            }
+
+            ext.clear();
+        }
+    }
 }
 
-void MediaLibraryModel::iterateFilesystemHelper(const QStringList &nameFilters, MediaType type)
+MediaLibraryModel::MediaType MediaLibraryModel::mediaType(const QString &file) const
 {
-    // build filelist with media type filters
-    this->FileSystemModel::setNameFilters(nameFilters);
-    this->FileSystemModel::iterateFilesystem(FileSystemModel::RelativePaths, true);
+    int ext_pos = file.lastIndexOf('.');
+    if (ext_pos != -1)
+    {
+        QHash<QString, MediaType>::const_iterator it = this->m_typeLookup.constFind(file.mid(ext_pos+1).toLower());
+        if (it != this->m_typeLookup.constEnd())
+            return it.value();
+    }
 
-    // build [Media] objects and append to list
-    this->buildMediaList(this->FileSystemModel::filelist(), type);
+    if (this->m_typeWildcards.isEmpty())
+        return None;
 
-    // clean up
-    this->FileSystemModel::clear();
-    this->FileSystemModel::clearNameFilters();
+    QString filename = file.mid(file.lastIndexOf('/') + 1);
+    for (const QPair<QRegExp, MediaType> &wildcard : this->m_typeWildcards)
+    {
+        if (wildcard.first.exactMatch(filename))
+            return wildcard.second;
+    }
+
+    return None;
+}
+
+// matches chunks of the remaining candidates of a search cursor, see SearchCursor::toList()
+class SearchWorker : public QRunnable
+{
+public:
+    SearchWorker(const MediaLibraryModel::SearchCursor *cursor, int from,
+                 QList<MediaLibraryModel::Media*> *chunks, int chunkCount, QAtomicInt *next)
+        : ptr_cursor(cursor),
+          m_from(from),
+          ptr_chunks(chunks),
+          m_chunkCount(chunkCount),
+          ptr_next(next)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        const int count = this->ptr_cursor->candidateCount();
+
+        int chunk;
+        while ((chunk = this->ptr_next->fetchAndAddRelaxed(1)) < this->m_chunkCount)
+        {
+            const int begin = this->m_from + chunk * SearchChunkSize;
+            const int end = qMin(begin + SearchChunkSize, count);
+            QList<MediaLibraryModel::Media*> &matches = this->ptr_chunks[chunk];
+
+            for (int i = begin; i < end; i++)
+            {
+                MediaLibraryModel::Media *media = this->ptr_cursor->candidate(i);
+                if (this->ptr_cursor->matches(media))
+                    matches.append(media);
+            }
+        }
+    }
+
+private:
+    const MediaLibraryModel::SearchCursor *ptr_cursor;
+    int m_from;
+    QList<MediaLibraryModel::Media*> *ptr_chunks;
+    int m_chunkCount;
+    QAtomicInt *ptr_next;
+};
+
+MediaLibraryModel::SearchCursor MediaLibraryModel::search(const QString &search_term, MediaType type) const
+{
+    return SearchCursor(this, SearchKeys(search_term, this->folding()), type);
 }
 
 MediaLibraryModel::Media *MediaLibraryModel::find(const QString &search_term, MediaType type) const
 {
-    // Create search patterns, if the search terms are empty, skip search and return nothing
-    SearchKeys search(search_term);
-    if (search.empty())
-        return nullptr;
+    return this->findBest(search_term, type, 1).value(0, nullptr);
+}
 
-    // Create sub lists <since we work with pointers, there is only minimal memory usage for the list allocation itself>
-    QList<Media*> filter_list;
-    QList<Media*> search_list;
+QList<MediaLibraryModel::Media*> MediaLibraryModel::findBest(const QString &search_term, MediaType type, int count, QList<Media*> *all) const
+{
+    struct Ranked {
+        int score;
+        int order; // position in the results, equally good matches keep the list order
+        Media *media;
+    };
+
+    // true if [r1] is a better result than [r2]
+    const auto better = [](const Ranked &r1, const Ranked &r2) {
+        if (r1.media->instrumental != r2.media->instrumental)
+            return r2.media->instrumental;
+        if (r1.score != r2.score)
+            return r1.score > r2.score;
+        return r1.order < r2.order;
+    };
+
+    const SearchKeys search(search_term, this->folding());
+
+    QList<WildcardMatcher> main;
+    for (const SearchKeys::SearchPattern &s : search.searchPatterns())
+    {
+        if (s.type == SearchKeys::Default || s.type == SearchKeys::IncludeIntoMainSearch)
+            main.append(s.searchPattern);
+    }
 
-    // Create a media type filter list
-    if (type == None)
+    // bounded heap with the worst of the best [count] results on top, the other results are dropped right away
+    QVector<Ranked> heap;
+    heap.reserve(qMax(count, 0));
+
+    const auto rank = [&](Media *media, int order) {
+        if (count <= 0)
+            return;
+
+        const Ranked ranked = {SearchCursor::score(media, main), order, media};
+
+        if (heap.size() < count)
+        {
+            heap.append(ranked);
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+
+        else if (better(ranked, heap.first()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.last() = ranked;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    };
+
+    // the results of a recent findMultiple() are only scored, otherwise the matches are scored
+    // while the cursor finds them; the full match set is only built if the caller asks for it
+    QList<Media*> matches;
+    if (this->cachedQuery(search, type, &matches))
     {
-        filter_list = this->m_media;
+        for (int order = 0; order < matches.size(); order++)
+            rank(matches.at(order), order);
+
+        if (all)
+            *all = matches;
     }
 
     else
     {
-        for (Media *media : this->m_media)
+        if (all)
+            all->clear();
+
+        SearchCursor cursor(this, search, type);
+        int order = 0;
+
+        while (Media *media = cursor.next())
         {
-            if (media->type == type)
-                filter_list.append(media);
+            rank(media, order++);
+
+            if (all)
+                all->append(media);
         }
     }
 
-    // Check if search keys has filter patterns
-    if (search.containsKey(SearchKeys::WithoutAnyOfThis) ||
-        search.containsKey(SearchKeys::WithoutGenre))
-    {
+    std::sort_heap(heap.begin(), heap.end(), better);
+
+    QList<Media*> results;
+    results.reserve(heap.size());
+    for (const Ranked &ranked : heap)
+        results.append(ranked.media);
+
+    return results;
+}
 
-        QList<SearchKeys::SearchPattern> WithoutAnyOfThis = search.searchPatterns(SearchKeys::WithoutAnyOfThis);
-        int WithoutAnyOfThisKeyCount = search.countKeys(SearchKeys::WithoutAnyOfThis);
+QList<MediaLibraryModel::Media*> MediaLibraryModel::findMultiple(const QString &search_term, MediaType type) const
+{
+    const SearchKeys search(search_term, this->folding());
 
-        QList<SearchKeys::SearchPattern> WithoutGenre = search.searchPatterns(SearchKeys::WithoutGenre);
-        int WithoutGenreKeyCount = search.countKeys(SearchKeys::WithoutGenre);
+    // random and shuffle ask for the same results over and over again
+    QList<Media*> cached;
+    if (this->cachedQuery(search, type, &cached))
+        return cached;
 
-        bool mark_as_dont_add = false;
+    const QString key = this->queryKey(search, type);
+    QueryResult *result = new QueryResult(SearchCursor(this, search), type);
+    result->generation = this->m_generation;
+    result->media = SearchCursor(this, search, type).toList();
 
-        for (Media *media : filter_list)
-        {
-            for (const QString &searchPath : media->searchPaths)
-            {
+    const QList<Media*> media = result->media;
+    this->m_queryCache.insert(key, result);
+    return media;
+}
 
-                // keyword filter
-                for (int i = 0; i < WithoutAnyOfThisKeyCount; i++)
-                {
-                    if (WithoutAnyOfThis.at(i).searchPattern.exactMatch(searchPath))
-                    {
-                        mark_as_dont_add = true;
-                        break; // we are done here
-                    }
-                }
+bool MediaLibraryModel::cachedQuery(const SearchKeys &search, MediaType type, QList<Media*> *media) const
+{
+    const QueryResult *cached = this->m_queryCache.object(this->queryKey(search, type));
+    if (!cached || cached->generation != this->m_generation)
+        return false;
 
-                // genre filter
-                for (int i = 0; i < WithoutGenreKeyCount; i++)
-                {
-                    if (WithoutGenre.at(i).searchPattern.exactMatch(media->tags.genre))
-                    {
-                        mark_as_dont_add = true;
-                        break; // we are done here
-                    }
-                }
-            }
+    *media = cached->media;
+    return true;
+}
+
+QString MediaLibraryModel::queryKey(const SearchKeys &search, MediaType type)
+{
+    // built from the parsed patterns, different spellings of the same search share the results
+    QString key = QString::number(type) + '|' +
+                  QString::number(search.minDuration()) + '|' +
+                  QString::number(search.maxDuration());
 
-            if (!mark_as_dont_add)
-                search_list.append(media);
+    for (const SearchKeys::SearchPattern &s : search.searchPatterns())
+        key += '|' + QString::number(s.type) + ':' + s.searchPattern.pattern();
 
-            mark_as_dont_add = false; // reset this for a new loop
-        }
+    return key;
+}
+
+MediaLibraryModel::SearchCursor::SearchCursor(const MediaLibraryModel *model, const SearchKeys &search)
+    : ptr_model(model),
+      m_search(search)
+{
+    // no candidates at all
+    this->m_indexed = true;
+
+    // split the patterns once, not for every media
+    for (const SearchKeys::SearchPattern &s : this->m_search.searchPatterns())
+    {
+        if (s.type == SearchKeys::Default || s.type == SearchKeys::IncludeIntoMainSearch)
+            this->m_main.append(s.searchPattern);
+        else if (s.type == SearchKeys::WithoutAnyOfThis)
+            this->m_without.append(s.searchPattern);
+        else if (s.type == SearchKeys::WithoutGenre)
+            this->m_withoutGenre.append(s.searchPattern);
     }
+}
 
-    else {
-        search_list = filter_list;
+MediaLibraryModel::SearchCursor::SearchCursor(const MediaLibraryModel *model, const SearchKeys &search, MediaType type)
+    : SearchCursor(model, search)
+{
+    // if the search terms are empty, there is nothing to find
+    if (this->m_search.empty())
+        return;
+
+    this->m_indexed = model->candidateIds(this->m_search, &this->m_candidates);
+
+    if (type == None)
+    {
+        this->ptr_list = &model->m_media;
+        return;
     }
 
-    // Search: Default, IncludeIntoMainSearch
-    for (Media *media : search_list)
+    // media of other types are never looked at, the search walks the partition of the type
+    QMap<MediaType, QList<Media*> >::const_iterator partition = model->m_media_sorted.constFind(type);
+    if (partition == model->m_media_sorted.constEnd())
     {
-        for (const QString &searchPath : media->searchPaths)
-        {
-            for (const SearchKeys::SearchPattern &s : search.searchPatterns())
-            {
-                if (s.type == SearchKeys::Default || s.type == SearchKeys::IncludeIntoMainSearch)
-                {
-                    if (s.searchPattern.exactMatch(searchPath))
-                    {
-                        filter_list.clear(); // remove pointer copies
-                        search_list.clear(); // remove pointer copies
-                        return media;
-                    }
-                }
-            }
-        }
+        this->m_indexed = true;
+        this->m_candidates.clear();
+        return;
     }
 
-    // remove pointer copies
-    filter_list.clear();
-    search_list.clear();
+    if (!this->m_indexed)
+    {
+        this->ptr_list = &partition.value();
+        return;
+    }
+
+    // the index works with positions in the media list, drop the candidates of other types in place
+    const QBitArray &bitmap = model->m_typeBitmaps.value(type);
+    this->m_candidates.erase(
+        std::remove_if(
+            this->m_candidates.begin(),
+            this->m_candidates.end(),
+            [&](int id) {
+                return !bitmap.testBit(id);
+            }),
+        this->m_candidates.end()
+    );
+}
+
+MediaLibraryModel::Media *MediaLibraryModel::SearchCursor::next()
+{
+    const int count = this->candidateCount();
+
+    while (this->m_pos < count)
+    {
+        Media *media = this->candidate(this->m_pos++);
+        if (this->matches(media))
+            return media;
+    }
 
-    // nothing found
     return nullptr;
 }
 
-QList<MediaLibraryModel::Media*> MediaLibraryModel::findMultiple(const QString &search_term, MediaType type) const
+QList<MediaLibraryModel::Media*> MediaLibraryModel::SearchCursor::toList()
 {
     QList<Media*> results;
 
-    // Create search patterns, if the search terms are empty, skip search and return nothing
-    SearchKeys search(search_term);
-    if (search.empty())
+    const int count = this->candidateCount();
+    const int remaining = count - this->m_pos;
+
+    // not worth the thread overhead
+    if (remaining < ParallelSearchThreshold || QThread::idealThreadCount() < 2)
+    {
+        while (Media *media = this->next())
+            results.append(media);
         return results;
+    }
 
-    // Create sub lists <since we work with pointers, there is only minimal memory usage for the list allocation itself>
-    QList<Media*> filter_list;
-    QList<Media*> search_list;
+    // every chunk has its own result list, the threads never write to the same list
+    const int chunkCount = (remaining + SearchChunkSize - 1) / SearchChunkSize;
+    const int threads = qMin(QThread::idealThreadCount(), chunkCount);
 
-    // Create a media type filter list
-    if (type == None)
+    QVector<QList<Media*> > chunks(chunkCount);
+    QAtomicInt next_chunk(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    for (int i = 0; i < threads; i++)
+        pool.start(new SearchWorker(this, this->m_pos, chunks.data(), chunkCount, &next_chunk));
+
+    pool.waitForDone();
+    this->m_pos = count;
+
+    // merge in chunk order, this keeps the order of the media list
+    for (const QList<Media*> &matches : chunks)
+        results.append(matches);
+
+    return results;
+}
+
+int MediaLibraryModel::SearchCursor::candidateCount() const
+{
+    return this->m_indexed ? this->m_candidates.size() : this->ptr_list->size();
+}
+
+MediaLibraryModel::Media *MediaLibraryModel::SearchCursor::candidate(int i) const
+{
+    return this->m_indexed ? this->ptr_model->m_media.at(this->m_candidates.at(i)) : this->ptr_list->at(i);
+}
+
+// rates a single match of a search pattern, higher is better
+//  × exactness: how much of the string is covered by the search terms
+//  × adjacency: search terms which follow each other directly
+//  × word starts: search terms which begin at the start of a word
+//  × position: matches in the file name (or the tags), the earlier the better
+static int scoreMatch(const QString &str, const QVector<WildcardMatcher::Match> &matches)
+{
+    if (matches.isEmpty())
+        return 0;
+
+    int score = 0;
+
+    int covered = 0;
+    for (const WildcardMatcher::Match &m : matches)
+        covered += m.length;
+    score += 1000 * covered / qMax(1, str.size());
+
+    for (int i = 1; i < matches.size(); i++)
     {
-        filter_list = this->m_media;
+        const int gap = matches.at(i).pos - (matches.at(i-1).pos + matches.at(i-1).length);
+        score += gap <= 1 ? 50 : -qMin(gap, 100);
     }
 
-    else
+    for (const WildcardMatcher::Match &m : matches)
+    {
+        if (m.pos == 0 || !str.at(m.pos - 1).isLetterOrNumber())
+            score += 50;
+    }
+
+    const int name = str.lastIndexOf('/') + 1;
+    if (matches.first().pos >= name)
+        score += 200 - qMin(matches.first().pos - name, 100);
+
+    return score;
+}
+
+int MediaLibraryModel::SearchCursor::score(const Media *media, const QList<WildcardMatcher> &main)
+{
+    // the tags are always the last search path, people search for artist and title more often than for paths
+    const bool tagged = !(media->tags.artist.isEmpty() &&
+                          media->tags.album.isEmpty() &&
+                          media->tags.title.isEmpty());
+
+    QVector<WildcardMatcher::Match> matches;
+    int best = INT_MIN;
+
+    for (int i = 0; i < media->foldedSearchPaths.size(); i++)
+    {
+        const QString &searchPath = media->foldedSearchPaths.at(i);
+        const int bonus = tagged && i == media->foldedSearchPaths.size() - 1 ? 150 : 0;
+
+        for (const WildcardMatcher &p : main)
+        {
+            if (p.match(searchPath, &matches))
+                best = qMax(best, scoreMatch(searchPath, matches) + bonus);
+        }
+    }
+
+    return best;
+}
+
+bool MediaLibraryModel::SearchCursor::matches(const Media *media) const
+{
+    // all candidates are of the requested type already
+
+    // duration filter, media with an unknown duration are never filtered out
+    if (!matchesDuration(media, this->m_search))
+        return false;
+
+    // keyword filter
+    for (const QString &searchPath : media->foldedSearchPaths)
     {
-        for (Media *media : this->m_media)
+        for (const WildcardMatcher &p : this->m_without)
         {
-            if (media->type == type)
-                filter_list.append(media);
+            if (p.exactMatch(searchPath))
+                return false;
         }
     }
 
-    // Check if search keys has filter patterns
-    if (search.containsKey(SearchKeys::WithoutAnyOfThis) ||
-        search.containsKey(SearchKeys::WithoutGenre))
+    // genre filter, the genre is only folded if there is a genre filter at all
+    // same folding as the search paths, the patterns were folded by the same SearchPathGens
+    if (!this->m_withoutGenre.isEmpty())
     {
+        const QString genre = this->ptr_model->foldString(media->tags.genre);
+        for (const WildcardMatcher &p : this->m_withoutGenre)
+        {
+            if (p.exactMatch(genre))
+                return false;
+        }
+    }
+
+    // Search: Default, IncludeIntoMainSearch
+    for (const QString &searchPath : media->foldedSearchPaths)
+    {
+        for (const WildcardMatcher &p : this->m_main)
+        {
+            if (p.exactMatch(searchPath))
+                return true;
+        }
+    }
+
+    return false;
+}
 
-        QList<SearchKeys::SearchPattern> WithoutAnyOfThis = search.searchPatterns(SearchKeys::WithoutAnyOfThis);
-        int WithoutAnyOfThisKeyCount = search.countKeys(SearchKeys::WithoutAnyOfThis);
+void MediaLibraryModel::buildSearchIndex() const
+{
+    this->m_searchIndex.clear();
+    this->m_searchPositions.resize(this->m_media.size());
+    this->m_searchDeadIds = 0;
 
-        QList<SearchKeys::SearchPattern> WithoutGenre = search.searchPatterns(SearchKeys::WithoutGenre);
-        int WithoutGenreKeyCount = search.countKeys(SearchKeys::WithoutGenre);
+    // the ids start as the positions in the media list
+    for (int i = 0; i < this->m_media.size(); i++)
+    {
+        Media *media = this->m_media.at(i);
+        media->searchId = i;
+        this->m_searchPositions[i] = i;
+        this->m_searchIndex.add(i, media->foldedSearchPaths);
+    }
 
-        bool mark_as_dont_add = false;
+    this->m_searchIndexOutdated = false;
+}
 
-        for (Media *media : filter_list)
-        {
-            for (const QString &searchPath : media->searchPaths)
-            {
+bool MediaLibraryModel::candidateIds(const SearchKeys &search, QVector<int> *ids) const
+{
+    ids->clear();
 
-                // keyword filter
-                for (int i = 0; i < WithoutAnyOfThisKeyCount; i++)
-                {
-                    if (WithoutAnyOfThis.at(i).searchPattern.exactMatch(searchPath))
-                    {
-                        mark_as_dont_add = true;
-                        break; // we are done here
-                    }
-                }
+    if (this->m_searchIndexOutdated)
+        this->buildSearchIndex();
 
-                // genre filter
-                for (int i = 0; i < WithoutGenreKeyCount; i++)
-                {
-                    if (WithoutGenre.at(i).searchPattern.exactMatch(media->tags.genre))
-                    {
-                        mark_as_dont_add = true;
-                        break; // we are done here
-                    }
-                }
-            }
+    // a media is a candidate if it may match any of the patterns, the candidates of all patterns are merged
+    // if a pattern has no literal of at least 3 characters, every media is a candidate
+    QVector<int> doc_ids, pattern_ids, merged;
 
-            if (!mark_as_dont_add)
-                search_list.append(media);
+    for (const SearchKeys::SearchPattern &s : search.searchPatterns())
+    {
+        if (s.type != SearchKeys::Default && s.type != SearchKeys::IncludeIntoMainSearch)
+            continue;
 
-            mark_as_dont_add = false; // reset this for a new loop
-        }
-    }
+        if (!this->m_searchIndex.candidates(s.searchPattern.literals(), &pattern_ids))
+            return false;
 
-    else {
-        search_list = filter_list;
+        merged.clear();
+        std::set_union(doc_ids.constBegin(), doc_ids.constEnd(),
+                       pattern_ids.constBegin(), pattern_ids.constEnd(),
+                       std::back_inserter(merged));
+        doc_ids.swap(merged);
     }
 
-    // Search: Default, IncludeIntoMainSearch
-    bool next;
-    for (Media *media : search_list)
+    // document ids to positions, media which are gone or were changed have no position anymore
+    ids->reserve(doc_ids.size());
+    for (const int id : doc_ids)
     {
-        for (const QString &searchPath : media->searchPaths)
-        {
-            for (const SearchKeys::SearchPattern &s : search.searchPatterns())
-            {
-                if (s.type == SearchKeys::Default || s.type == SearchKeys::IncludeIntoMainSearch)
-                {
-                    if (s.searchPattern.exactMatch(searchPath))
-                    {
-                        results.append(media);
-
-                        next = true;
-                        break;
-                    }
-                }
-
-                if (next) break;
-            }
+        const int pos = this->m_searchPositions.at(id);
+        if (pos != -1)
+            ids->append(pos);
+    }
 
-            if (next) break;
-        }
+    std::sort(ids->begin(), ids->end());
+    return true;
+}
 
-        next = false;
-    }
+bool MediaLibraryModel::matchesDuration(const Media *media, const SearchKeys &search)
+{
+    const int duration = media->properties.duration;
+    if (duration == -1)
+        return true;
 
-    // remove pointer copies
-    filter_list.clear();
-    search_list.clear();
+    if (search.minDuration() != -1 && duration < search.minDuration())
+        return false;
+    if (search.maxDuration() != -1 && duration > search.maxDuration())
+        return false;
 
-    // return results
-    return results;
+    return true;
 }
 
 int MediaLibraryModel::count(MediaType type) const
@@ -447,11 +1325,117 @@ MediaLibraryModel::Media *MediaLibraryModel::at(int pos, MediaType type) const
     return nullptr;
 }
 
-void MediaLibraryModel::buildMediaList(const QStringList *list, MediaType type)
+MediaLibraryModel::DirectoryContext MediaLibraryModel::directoryContext(const QString &dir) const
+{
+    DirectoryContext context;
+
+    // remove the prefixes from the directory part, same rules as for the whole path
+    // a prefix which may reach into the file names can't be decided here, fall back to the whole path
+    context.path = dir.isEmpty() ? QString() : dir + '/';
+    context.hoisted = true;
+
+    for (const QString &prefix : this->m_prefixDeletionPatterns)
+    {
+        if (context.path.startsWith(prefix))
+            context.path.remove(0, prefix.size());
+
+        else if (prefix.startsWith(context.path))
+        {
+            context.hoisted = false;
+            return context;
+        }
+    }
+
+    // canonical search mode, the SearchPathGens don't generate anything
+    if (this->m_canonicalSearch)
+        return context;
+
+    // generate the search paths of the directory part
+    for (const SearchPathGen *gen : this->m_searchPathGens)
+    {
+        if (!gen->isPathSegmentSafe())
+        {
+            context.hoisted = false;
+            return context;
+        }
+
+        context.searchPaths.append(gen->processString(context.path));
+    }
+
+    return context;
+}
+
+// reads the tags of a shared list of media, every worker takes the next unread one
+class TagsReaderWorker : public QRunnable
+{
+public:
+    TagsReaderWorker(const QList<MediaLibraryModel::Media*> *media, QAtomicInt *next)
+        : ptr_media(media),
+          ptr_next(next)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        int i;
+        while ((i = this->ptr_next->fetchAndAddRelaxed(1)) < this->ptr_media->size())
+            MediaLibraryModel::readTags(this->ptr_media->at(i));
+    }
+
+private:
+    const QList<MediaLibraryModel::Media*> *ptr_media;
+    QAtomicInt *ptr_next;
+};
+
+void MediaLibraryModel::readTags(Media *media)
+{
+    // broken or very slow files are skipped until they change
+    if (MediaCache::i()->isQuarantined(media))
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    MediaTagsReader reader(media);
+    MediaCache::i()->recordTagsRead(media, timer.elapsed(), reader.failed());
+}
+
+void MediaLibraryModel::readTags(const QList<Media*> &media)
 {
+    if (media.isEmpty())
+        return;
+
+    // tag reading waits on the disk most of the time, more threads than cores keep the I/O queue busy
+    // every file gets its own TagLib objects, the readers don't share any state
+    const int threads = qBound(1, QThread::idealThreadCount() * 2, media.size());
+
+    QAtomicInt next(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    for (int i = 0; i < threads; i++)
+        pool.start(new TagsReaderWorker(&media, &next));
+
+    pool.waitForDone();
+}
+
+void MediaLibraryModel::buildMediaList(const QStringList *list, QList<Media*> *target)
+{
+    // work which is the same for all files of a directory is only done once
+    QHash<QString, DirectoryContext> directories;
+
+    // media without cached data, their tags are read in parallel after all paths are processed
+    // or by loadTags() later on if lazy tags are enabled
+    QList<Media*> uncached;
+
     for (const QString &f : *list)
     {
 
+        // sort the file into its media type, skip files which don't match any name filter
+        MediaType type = this->mediaType(f);
+        if (type == None)
+            continue;
+
         // create a new media object
         Media *media = new Media;
 
@@ -467,13 +1451,12 @@ void MediaLibraryModel::buildMediaList(const QStringList *list, MediaType type)
         if (ext_pos != -1)
             media->fileformat = media->path.mid(ext_pos+1).toLower();
 
-        // remove set prefixes from the file path to reduce memory usage and processing time later
-        // also adds the possibility to clean up the search results
-        // prefix deletion patterns are case-sensitive, no wildcards or regular expressions supported
-        QString _f = f;
-        for (const QString &prefix : this->m_prefixDeletionPatterns)
-            if (_f.startsWith(prefix))
-                _f.remove(0, prefix.size());
+        int sep = f.lastIndexOf('/');
+        const QString dir = sep == -1 ? QString() : f.left(sep);
+
+        QHash<QString, DirectoryContext>::const_iterator context = directories.constFind(dir);
+        if (context == directories.constEnd())
+            context = directories.insert(dir, this->directoryContext(dir));
 
         // don't read tags here, takes literally forever
         // read tags when the media is requested for the first time
@@ -501,56 +1484,168 @@ void MediaLibraryModel::buildMediaList(const QStringList *list, MediaType type)
         //
 
         // check for cached data and use this, if no cached data was found, we generate one
-        MediaCache::i()->setMedia(media);
-        if (MediaCache::i()->hasMedia())
+        bool cached = false;
+        {
+            QMutexLocker lock(&this->m_scanMutex);
+            MediaCache::i()->setMedia(media);
+            if (MediaCache::i()->hasMedia())
+            {
+                MediaCache::i()->getCachedData();
+                cached = true;
+            }
+        }
+
+        if (cached)
         {
-            MediaCache::i()->getCachedData();
+            this->foldSearchPaths(media);
+
+            // cached before the audio properties were enabled
+            if (this->m_audioProperties && !media->properties.probed)
+            {
+                QMutexLocker lock(&this->m_backgroundMutex);
+                this->m_unprobed.append(*media);
+            }
         }
 
         // no cached data found, generate one
         else
         {
 
-            // add 'cleaned' path to search paths
-            media->searchPaths.append(_f);
+            // remove set prefixes from the file path to reduce memory usage and processing time later
+            // also adds the possibility to clean up the search results
+            // prefix deletion patterns are case-sensitive, no wildcards or regular expressions supported
+            QString _f;
+
+            if (context->hoisted)
+            {
+                const QString name = f.mid(sep + 1);
+                _f = context->path + name;
+
+                // add 'cleaned' path to search paths
+                media->searchPaths.append(_f);
+
+                // generate search paths, only the file name needs to be processed
+                // more SearchPathGens means longer processing and higher memory usage
+                for (int i = 0; i < context->searchPaths.size(); i++)
+                {
+                    const QStringList &dirPaths = context->searchPaths.at(i);
+                    const QStringList namePaths = this->m_searchPathGens.at(i)->processString(name);
+
+                    for (int j = 0; j < namePaths.size(); j++)
+                        media->searchPaths.append(dirPaths.value(j) + namePaths.at(j));
+                }
+            }
 
-            // generate search paths
-            // more SearchPathGens means longer processing and higher memory usage
-            for (const SearchPathGen *gen : this->m_searchPathGens)
-                media->searchPaths.append(gen->processString(_f));
+            else
+            {
+                _f = f;
+                for (const QString &prefix : this->m_prefixDeletionPatterns)
+                    if (_f.startsWith(prefix))
+                        _f.remove(0, prefix.size());
+
+                // add 'cleaned' path to search paths
+                media->searchPaths.append(_f);
+
+                // generate search paths, not in canonical search mode
+                // more SearchPathGens means longer processing and higher memory usage
+                if (!this->m_canonicalSearch)
+                    for (const SearchPathGen *gen : this->m_searchPathGens)
+                        media->searchPaths.append(gen->processString(_f));
+            }
+
+            _f.clear();
 
             // remove duplicates from search paths
             // the SearchPathGens may not always create a "new" string
             // so lets remove the duplicates to save memory
             (void) media->searchPaths.removeDuplicates();
 
-            // read tags
-            MediaTagsReader reader(media);
-            Q_UNUSED(reader); // get rid of compiler warning
-
-            // add artist, album and title to search paths, to provide better lookups
-            // don't add, if all of these 3 fields are empty
-            // ignore the other tags
-            if (!(media->tags.artist.isEmpty() &&
-                media->tags.album.isEmpty() &&
-                media->tags.title.isEmpty()))
-                media->searchPaths.append(media->tags.artist + ' ' +
-                                          media->tags.album + ' ' +
-                                          media->tags.title);
-
-            // write data to cache file
-            (void) MediaCache::i()->createMedia();
-
+            uncached.append(media);
         }
 
         // add to list
-        this->m_media.append(media);
+        target->append(media);
+    }
+
+    // the media are published without tags, the cache entry is written when the tags are there
+    if (this->m_lazyTags)
+    {
+        QMutexLocker lock(&this->m_backgroundMutex);
+        for (Media *media : uncached)
+        {
+            this->foldSearchPaths(media);
+            this->m_untagged.append(*media);
+        }
+        return;
+    }
+
+    // read tags
+    this->readTags(uncached);
+
+    // the cache is written by this thread only, every media gets exactly one entry
+    for (Media *media : uncached)
+    {
+        this->appendTagsSearchPath(media);
+        this->foldSearchPaths(media);
+    }
+
+    // write data to cache file
+    {
+        QMutexLocker lock(&this->m_scanMutex);
+        for (Media *media : uncached)
+        {
+            MediaCache::i()->setMedia(media, true);
+            (void) MediaCache::i()->createMedia();
+        }
+    }
+
+    // the audio properties are never waited for
+    if (this->m_audioProperties)
+    {
+        QMutexLocker lock(&this->m_backgroundMutex);
+        for (const Media *media : uncached)
+            this->m_unprobed.append(*media);
+    }
+}
+
+void MediaLibraryModel::appendTagsSearchPath(Media *media)
+{
+    // add artist, album and title to search paths, to provide better lookups
+    // don't add, if all of these 3 fields are empty
+    // ignore the other tags
+    if (!(media->tags.artist.isEmpty() &&
+        media->tags.album.isEmpty() &&
+        media->tags.title.isEmpty()))
+        media->searchPaths.append(media->tags.artist + ' ' +
+                                  media->tags.album + ' ' +
+                                  media->tags.title);
+}
+
+void MediaLibraryModel::foldSearchPaths(Media *media) const
+{
+    // folded once here instead of on every character of every search
+    // most paths are plain lower-case already, share the string data with the original in this case
+    media->foldedSearchPaths.clear();
+    media->foldedSearchPaths.reserve(media->searchPaths.size());
 
-        // clean up
-        _f.clear();
+    for (const QString &searchPath : media->searchPaths)
+    {
+        const QString folded = this->foldString(searchPath);
+        media->foldedSearchPaths.append(folded == searchPath ? searchPath : folded);
     }
 }
 
+QString MediaLibraryModel::foldString(const QString &str) const
+{
+    QString folded = str;
+
+    // canonical search mode, the one form which stands for all variants the SearchPathGens would generate
+    for (const SearchPathGen *gen : this->folding())
+        folded = gen->fold(folded);
+
+    return folded.toCaseFolded();
+}
+
 void MediaLibraryModel::finalizeMediaList()
 {
     // remove redundant data (saves about 30% memory usage process internally)  :)
@@ -570,6 +1665,309 @@ void MediaLibraryModel::finalizeMediaList()
     // copy pointers to a MediaType categorized media list map
     // for quick and easy [MediaType] access
     this->createSortedMediaList();
+
+    // build the search index right away, the first search shouldn't pay for it
+    this->buildSearchIndex();
+
+    // path lookup for incremental updates
+    this->m_mediaByPath.clear();
+    this->m_mediaByPath.reserve(this->m_media.size());
+    for (Media *media : this->m_media)
+        this->m_mediaByPath.insert(media->path, media);
+}
+
+void MediaLibraryModel::removeMedia(const QStringList &paths)
+{
+    QSet<Media*> gone;
+
+    for (const QString &path : paths)
+    {
+        Media *media = this->m_mediaByPath.take(path);
+        if (media) gone.insert(media);
+    }
+
+    if (gone.isEmpty())
+        return;
+
+    this->updateSearchIndex(gone, QList<Media*>());
+
+    this->m_media.erase(
+        std::remove_if(
+            this->m_media.begin(),
+            this->m_media.end(),
+            [&](Media *media) {
+                return gone.contains(media);
+            }),
+        this->m_media.end()
+    );
+
+    qDeleteAll(gone);
+}
+
+void MediaLibraryModel::updateSearchIndex(const QSet<Media*> &gone, const QList<Media*> &changed)
+{
+    // drop the cached results which contain one of the media or which the changed media would match now,
+    // all other results don't change, the order of the other media in the list stays the same
+    for (const QString &key : this->m_queryCache.keys())
+    {
+        const QueryResult *result = this->m_queryCache.object(key);
+        bool affected = result->generation != this->m_generation;
+
+        for (int i = 0; i < result->media.size() && !affected; i++)
+            affected = gone.contains(result->media.at(i));
+
+        for (int i = 0; i < changed.size() && !affected; i++)
+        {
+            const Media *media = changed.at(i);
+            affected = (result->type == None || media->type == result->type) && result->filter.matches(media);
+        }
+
+        if (affected)
+            this->m_queryCache.remove(key);
+    }
+
+    // built from scratch by the next search anyway
+    if (this->m_searchIndexOutdated)
+        return;
+
+    // the old ids of changed media stay in the index, but they don't have a position anymore
+    for (const Media *media : gone)
+    {
+        if (media->searchId != -1)
+            this->m_searchDeadIds++;
+    }
+
+    for (Media *media : changed)
+    {
+        if (media->searchId != -1 && !gone.contains(media))
+            this->m_searchDeadIds++;
+
+        // ids are always appended in ascending order
+        media->searchId = this->m_searchPositions.size();
+        this->m_searchPositions.append(-1);
+        this->m_searchIndex.add(media->searchId, media->foldedSearchPaths);
+    }
+}
+
+void MediaLibraryModel::insertMedia(QList<Media*> &media)
+{
+    // never add the same file twice
+    for (int i = 0; i < media.size(); i++)
+    {
+        if (this->m_mediaByPath.contains(media.at(i)->path))
+        {
+            delete media.takeAt(i);
+            i--;
+        }
+
+        else
+        {
+            media.at(i)->instrumental = this->isInstrumental(media.at(i));
+            this->m_mediaByPath.insert(media.at(i)->path, media.at(i));
+        }
+    }
+
+    if (media.isEmpty())
+        return;
+
+    std::sort(media.begin(), media.end(), this->lessThan);
+
+    // merge the new media into the (already ordered) media list
+    // only the insert positions are searched, the rest is just copied over
+    QList<Media*> merged;
+    merged.reserve(this->m_media.size() + media.size());
+
+    QList<Media*>::const_iterator from = this->m_media.constBegin();
+    for (Media *m : media)
+    {
+        QList<Media*>::const_iterator pos = std::upper_bound(from, this->m_media.constEnd(), m, this->lessThan);
+        for (; from != pos; ++from)
+            merged.append(*from);
+        merged.append(m);
+    }
+
+    for (; from != this->m_media.constEnd(); ++from)
+        merged.append(*from);
+
+    this->m_media = merged;
+}
+
+bool MediaLibraryModel::loadSnapshot()
+{
+    if (this->m_snapshotFile.isEmpty())
+        return false;
+
+    QFile file(this->m_snapshotFile);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < 8 || file.size() > INT_MAX)
+        return false;
+
+    // map the whole file, the checksum and the deserialization read it without copying it first
+    // all early returns leave the unmapping to the QFile
+    uchar *map = file.map(0, file.size());
+    if (!map)
+        return false;
+
+    // the checksum of everything before it is stored at the end, don't trust a truncated or broken file
+    const int size = int(file.size()) - 8;
+    if (xxh64(map, size) != qFromLittleEndian<quint64>(map + size))
+        return false;
+
+    const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(map), size);
+    QDataStream data(raw);
+    data.setVersion(QDataStream::Qt_5_0);
+    data.setByteOrder(QDataStream::LittleEndian); // strings are read without byte swapping on x86
+
+    quint32 magic = 0, version = 0, count = 0;
+    QString rootPath;
+    QStringList nameFilters, prefixDeletionPatterns;
+    bool canonicalSearch = false;
+
+    this->applyDefaultNameFilters();
+
+    data >> magic >> version;
+    if (magic != SnapshotMagic || version != SnapshotVersion)
+        return false;
+
+    // the media list depends on the root path, the name filters, the prefix deletion patterns
+    // and the search mode (the search paths are different in canonical search mode)
+    data >> rootPath >> nameFilters >> prefixDeletionPatterns >> canonicalSearch;
+    if (data.status() != QDataStream::Ok ||
+        rootPath != this->rootPath() ||
+        nameFilters != this->nameFilters() ||
+        prefixDeletionPatterns != this->m_prefixDeletionPatterns ||
+        canonicalSearch != this->m_canonicalSearch)
+        return false;
+
+    DirectoryState state;
+    data >> count;
+    if (data.status() != QDataStream::Ok || count > (size - data.device()->pos()) / SnapshotMinDirectorySize)
+        return false;
+
+    state.reserve(count);
+
+    for (quint32 i = 0; i < count && data.status() == QDataStream::Ok; i++)
+    {
+        QString dir;
+        ParallelDirWalker::Directory entry;
+
+        data >> dir >> entry.mtime >> entry.inode >> entry.files >> entry.subdirs;
+        state.insert(dir, entry);
+    }
+
+    QList<Media*> media;
+    data >> count;
+    if (data.status() != QDataStream::Ok || count > (size - data.device()->pos()) / SnapshotMinMediaSize)
+        return false;
+
+    media.reserve(count);
+
+    for (quint32 i = 0; i < count && data.status() == QDataStream::Ok; i++)
+    {
+        Media *m = new Media;
+        quint8 type = 0;
+
+        data >> m->path >> m->fileformat >> type >> m->instrumental >> m->searchPaths
+             >> m->tags.artist >> m->tags.album >> m->tags.title >> m->tags.genre
+             >> m->properties.probed >> m->properties.duration >> m->properties.bitrate
+             >> m->properties.sampleRate >> m->properties.channels;
+
+        m->type = static_cast<MediaType>(type);
+        this->foldSearchPaths(m);
+        media.append(m);
+    }
+
+    file.unmap(map);
+
+    // don't trust a truncated or broken file
+    if (data.status() != QDataStream::Ok)
+    {
+        qDeleteAll(media);
+        return false;
+    }
+
+    QMutexLocker lock(&this->m_scanRunMutex);
+
+    this->clear();
+    this->discardPendingUpdates();
+
+    // the name filters are required for later updates
+    this->buildMediaTypeLookup();
+
+    // the snapshot is already in the final order, no sorting required
+    this->m_media = media;
+    this->createSortedMediaList();
+
+    this->m_mediaByPath.reserve(this->m_media.size());
+    for (Media *m : this->m_media)
+        this->m_mediaByPath.insert(m->path, m);
+
+    // the tags of the last session may not be complete, media with tags in the cache are cheap to look up
+    // the tags loader reads the audio properties together with the tags
+    if (this->m_lazyTags || this->m_audioProperties)
+    {
+        QMutexLocker background_lock(&this->m_backgroundMutex);
+        for (const Media *m : this->m_media)
+        {
+            if (this->m_lazyTags && m->tags.isEmpty())
+                this->m_untagged.append(*m);
+            else if (this->m_audioProperties && !m->properties.probed)
+                this->m_unprobed.append(*m);
+        }
+    }
+
+    this->commitDirectoryState(state);
+    this->m_publishedState = state;
+    this->m_snapshotOutdated = false;
+
+    return true;
+}
+
+bool MediaLibraryModel::saveSnapshot()
+{
+    if (this->m_snapshotFile.isEmpty() || !this->m_snapshotOutdated)
+        return false;
+
+    // the first scan didn't finish yet, a snapshot without directory state can't be validated
+    if (this->m_publishedState.isEmpty())
+        return false;
+
+    // serialized into memory first, the checksum is written at the end
+    QByteArray raw;
+    QDataStream data(&raw, QIODevice::WriteOnly);
+    data.setVersion(QDataStream::Qt_5_0);
+    data.setByteOrder(QDataStream::LittleEndian);
+
+    data << SnapshotMagic << SnapshotVersion
+         << this->rootPath() << this->nameFilters() << this->m_prefixDeletionPatterns << this->m_canonicalSearch;
+
+    data << quint32(this->m_publishedState.size());
+    for (DirectoryState::const_iterator it = this->m_publishedState.constBegin(); it != this->m_publishedState.constEnd(); ++it)
+        data << it.key() << it->mtime << it->inode << it->files << it->subdirs;
+
+    // keep the list order, instrumental tracks stay at the bottom
+    data << quint32(this->m_media.size());
+    for (const Media *m : this->m_media)
+    {
+        data << m->path << m->fileformat << quint8(m->type) << m->instrumental << m->searchPaths
+             << m->tags.artist << m->tags.album << m->tags.title << m->tags.genre
+             << m->properties.probed << m->properties.duration << m->properties.bitrate
+             << m->properties.sampleRate << m->properties.channels;
+    }
+
+    if (data.status() != QDataStream::Ok)
+        return false;
+
+    uchar checksum[8];
+    qToLittleEndian<quint64>(xxh64(reinterpret_cast<const uchar*>(raw.constData()), raw.size()), checksum);
+    raw.append(reinterpret_cast<const char*>(checksum), 8);
+
+    // never leave a half written snapshot behind
+    QSaveFile file(this->m_snapshotFile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(raw) != raw.size() || !file.commit())
+        return false;
+
+    this->m_snapshotOutdated = false;
+    return true;
 }
 
 void MediaLibraryModel::moveInstrumentalTracksToBottom()
@@ -583,13 +1981,9 @@ void MediaLibraryModel::moveInstrumentalTracksToBottom()
 
     for (Media *media : this->m_media)
     {
+        media->instrumental = this->isInstrumental(media);
 
-        // support Latin1 and Wide-Latin (Unicode)
-        if (media->path.contains("instrumental", Qt::CaseInsensitive) ||
-            media->path.contains("ｉｎｓｔｒｕｍｅｎｔａｌ", Qt::CaseInsensitive) ||
-            media->path.contains("off vocal", Qt::CaseInsensitive) ||             // --
-            media->path.contains("ｏｆｆ ｖｏｃａｌ", Qt::CaseInsensitive) ||        //  |-- typical phrases for japenese instrumental tracks
-            media->path.contains("ｏｆｆ　ｖｏｃａｌ", Qt::CaseInsensitive))         // --
+        if (media->instrumental)
             list_inst->append(media);
 
         else list_main->append(media);
@@ -607,35 +2001,88 @@ void MediaLibraryModel::moveInstrumentalTracksToBottom()
     delete list_inst;
 }
 
+bool MediaLibraryModel::isInstrumental(const Media *media)
+{
+    // support Latin1 and Wide-Latin (Unicode)
+    return media->path.contains("instrumental", Qt::CaseInsensitive) ||
+           media->path.contains("ｉｎｓｔｒｕｍｅｎｔａｌ", Qt::CaseInsensitive) ||
+           media->path.contains("off vocal", Qt::CaseInsensitive) ||             // --
+           media->path.contains("ｏｆｆ ｖｏｃａｌ", Qt::CaseInsensitive) ||        //  |-- typical phrases for japenese instrumental tracks
+           media->path.contains("ｏｆｆ　ｖｏｃａｌ", Qt::CaseInsensitive);         // --
+}
+
+bool MediaLibraryModel::lessThan(const Media *m1, const Media *m2)
+{
+    if (m1->instrumental != m2->instrumental)
+        return m2->instrumental;
+
+    if (m1->type != m2->type)
+        return m1->type < m2->type;
+
+    return m1->path < m2->path;
+}
+
 void MediaLibraryModel::createSortedMediaList()
 {
+    this->m_media_sorted.clear();
+    this->m_typeBitmaps.clear();
+
+    // too many dead ids in the search index, the next search builds it again
+    if (!this->m_searchIndexOutdated && this->m_searchDeadIds > this->m_media.size())
+    {
+        this->m_searchIndex.clear();
+        this->m_searchIndexOutdated = true;
+    }
+
+    // the positions of the search index documents, the ids don't change with the list
+    if (!this->m_searchIndexOutdated)
+        this->m_searchPositions.fill(-1);
+
     if (this->m_media.isEmpty())
         return;
 
-    this->m_media_sorted.clear();
-
     QList<Media*> la, lv, lm;
 
-    for (Media *media : this->m_media)
+    // one bit per position in the media list, used to filter the search index candidates by type
+    QBitArray ba(this->m_media.size()), bv(this->m_media.size()), bm(this->m_media.size());
+
+    for (int i = 0; i < this->m_media.size(); i++)
     {
+        Media *media = this->m_media.at(i);
+
+        if (!this->m_searchIndexOutdated && media->searchId != -1)
+            this->m_searchPositions[media->searchId] = i;
 
         // Audio
         if (media->type == Audio)
+        {
             la.append(media);
+            ba.setBit(i);
+        }
 
         // Video
         else if (media->type == Video)
+        {
             lv.append(media);
+            bv.setBit(i);
+        }
 
         // ModuleTracker
         else if (media->type == ModuleTracker)
+        {
             lm.append(media);
+            bm.setBit(i);
+        }
     }
 
     this->m_media_sorted.insert(Audio, la);
     this->m_media_sorted.insert(Video, lv);
     this->m_media_sorted.insert(ModuleTracker, lm);
 
+    this->m_typeBitmaps.insert(Audio, ba);
+    this->m_typeBitmaps.insert(Video, bv);
+    this->m_typeBitmaps.insert(ModuleTracker, bm);
+
     la.clear();
     lv.clear();
     lm.clear();
@@ -650,6 +2097,19 @@ void MediaLibraryModel::clear()
 
     this->m_media.clear();
     this->m_media_sorted.clear();
+    this->m_typeBitmaps.clear();
+    this->m_mediaByPath.clear();
+    this->m_searchIndex.clear();
+    this->m_searchIndexOutdated = true;
+    this->m_searchPositions.clear();
+    this->m_searchDeadIds = 0;
+    this->m_generation++;
+
+    {
+        QMutexLocker lock(&this->m_backgroundMutex);
+        this->m_untagged.clear();
+        this->m_unprobed.clear();
+    }
 
     this->FileSystemModel::clear();
 }
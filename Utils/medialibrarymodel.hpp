@@ -5,10 +5,18 @@
 
 #include <Utils/searchpathgen.hpp>
 #include <Utils/searchkeys.hpp>
+#include <Utils/trigramindex.hpp>
 
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QSet>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVector>
+#include <QBitArray>
+#include <QCache>
+#include <QRegExp>
 
 class MediaLibraryModel : public FileSystemModel
 {
@@ -35,14 +43,27 @@ public:
         QString genre;
     };
 
+    struct MediaProperties {
+        bool probed = false; // false until the properties were read (or at least tried to)
+        int duration = -1;   // seconds, -1 if unknown
+        int bitrate = 0;     // kb/s
+        int sampleRate = 0;  // Hz
+        int channels = 0;
+    };
+
     struct Media {
         ~Media();
         QString fileformat; // just stores the file extension
 
         QString path;
         QStringList searchPaths;
+        QStringList foldedSearchPaths; // case-folded copy of [searchPaths], the search patterns are matched against it
         MediaTags tags;
+        MediaProperties properties; // only read if audio properties are enabled
         MediaType type;
+
+        bool instrumental = false; // set by the model, see moveInstrumentalTracksToBottom()
+        int searchId = -1;         // document id in the search index of the model, see buildSearchIndex()
     };
 
     void clear(); // delete the whole media database
@@ -56,14 +77,142 @@ public:
 
     void addSearchPathGen(SearchPathGen *);
 
+    // rebuilds the library from scratch, a running background scan is stopped before the media list is cleared
     void iterateFilesystem();
 
-    // DEVNOTE / TODO:
-    //  find() and findMultiple() has almost the same code
-    //  try to split that code redundancy out
-    //  and move in into a _helper function
-    Media *find(const QString &search_term, MediaType = None) const; // returns nullptr if nothing was found, don't forget to check against it!!
+    // incremental rescan, only new and changed directories are read from disk
+    // media objects of unchanged directories are kept as they are
+    // falls back to a full scan if there is no directory state from a previous scan
+    //
+    // NOTE: files which were modified in place (tag editing) are not detected,
+    //       run a full scan [iterateFilesystem()] in this case
+    void rescan();
+
+    // thread-safe: builds the library for the first time, blocks until the scan is finished
+    // the media objects are queued in batches and become visible with every applyPendingUpdates() call,
+    // means the library can be used while the scan is still running
+    void scanFilesystem();
+
+    // thread-safe: reads the given directories (relative to the root path) and all of their subdirectories
+    // again and queues the changes, [modified] files are built again even if their directory didn't change
+    // the changes are not visible before the next call of applyPendingUpdates()
+    void updateDirectories(const QStringList &dirs, const QStringList &modified = QStringList());
+
+    // applies all queued changes to the media list, returns false if there was nothing to do
+    // NOTE: call this only from the thread which uses the model, never while media pointers are in use
+    bool applyPendingUpdates();
+
+    // thread-safe: returns all directories of the library, relative to the root path
+    QStringList directories() const;
+
+    // thread-safe: increased whenever a scan committed a new directory state, directories() changed
+    int directoriesRevision() const;
+
+    // thread-safe: stops running scans and ignores all further scan requests, use this before exiting
+    void cancelScans();
+
+    // thread-safe: progress of the running scan, number of media objects built so far and in total
+    bool isScanning() const;
+    int scanProgress() const;
+    int scanTotal() const;
+
+    // lazy tags: media without cached data are published with their path based search paths only,
+    // the tags are read later by loadTags() and queued like all other changes
+    // NOTE: set this before the library is built or restored from the snapshot
+    void setLazyTags(bool enabled);
+    bool lazyTags() const;
+
+    // thread-safe: reads the tags of up to [count] media which don't have them yet,
+    // stores them in the MediaCache and queues them; returns false if there was nothing to do
+    bool loadTags(int count);
+
+    // thread-safe: number of media which are still waiting for their tags
+    int untaggedCount() const;
+
+    // audio properties (duration, bitrate, ...) are read in the background by loadProperties()
+    // and stored in the MediaCache, the search term filters |min and |max depend on them
+    // NOTE: set this before the library is built or restored from the snapshot
+    void setAudioProperties(bool enabled);
+    bool audioProperties() const;
+
+    // thread-safe: reads the audio properties of up to [count] media which don't have them yet,
+    // stores them in the MediaCache and queues them; returns false if there was nothing to do
+    bool loadProperties(int count);
+
+    // thread-safe: number of media which are still waiting for their audio properties
+    int unprobedCount() const;
+
+    // canonical search: every path is stored once, instead of one search path per SearchPathGen variant
+    // the search paths and the search terms are folded to a single form by the SearchPathGens
+    // (whitespaces, kana to hiragana, fullwidth to Basic-Latin1 and case)
+    // NOTE: set this before the library is built or restored from the snapshot,
+    //       the MediaCache must not be shared with a library which uses the other mode
+    void setCanonicalSearch(bool enabled);
+    bool canonicalSearch() const;
+
+    // library snapshot: the finalized media list (including search paths and tags) and the
+    // directory state of the last scan in a single file, replaces the full scan on startup
+    // the snapshot is only used if the root path, name filters and prefix deletion patterns are still the same
+    void setSnapshotFile(const QString &file);
+
+    // replaces the media list with the contents of the snapshot, returns false if there is no usable snapshot
+    // (the snapshot is protected by a checksum, a truncated or broken file is never used)
+    // the snapshot may be outdated, compare it with the filesystem using updateDirectories()
+    bool loadSnapshot();
+
+    // writes the snapshot if the media list changed since it was loaded or saved the last time
+    bool saveSnapshot();
+
+    // lazy search results, every call of next() walks the candidates until the next match is found
+    // no lists are built while searching, stop iterating whenever enough results were found
+    // NOTE: a cursor is only valid until the media list changes, see applyPendingUpdates()
+    class SearchCursor
+    {
+    public:
+        Media *next();          // returns nullptr if there are no more results
+        QList<Media*> toList(); // all remaining results, large libraries are matched by multiple threads
+
+    private:
+        friend class MediaLibraryModel;
+        friend class SearchWorker;
+
+        SearchCursor(const MediaLibraryModel *model, const SearchKeys &search, MediaType type);
+
+        // without any candidates, only used to check single media with matches()
+        SearchCursor(const MediaLibraryModel *model, const SearchKeys &search);
+
+        int candidateCount() const;
+        Media *candidate(int i) const;
+
+        // media type, search term filters and the main search patterns
+        bool matches(const Media *media) const;
+
+        // how well a matching media fits the main search patterns, higher is better
+        static int score(const Media *media, const QList<WildcardMatcher> &main);
+
+        const MediaLibraryModel *ptr_model;
+        const QList<Media*> *ptr_list = nullptr; // the media list or the partition of the type, if the index isn't used
+        SearchKeys m_search;
+
+        QList<WildcardMatcher> m_main;         // Default, IncludeIntoMainSearch
+        QList<WildcardMatcher> m_without;      // WithoutAnyOfThis
+        QList<WildcardMatcher> m_withoutGenre; // WithoutGenre
+
+        bool m_indexed = false;    // false if every media is a candidate
+        QVector<int> m_candidates; // positions in the media list, of the requested type only
+        int m_pos = 0;
+    };
+
+    SearchCursor search(const QString &search_term, MediaType = None) const;
+
+    Media *find(const QString &search_term, MediaType = None) const; // returns the best match, nullptr if nothing was found, don't forget to check against it!!
+
+    // the [count] best matches, the best first, see SearchCursor::score()
+    // instrumental tracks are ranked below all other tracks, equally good matches keep the list order
+    // all matches are scored while they are found, [all] receives them in list order if given
+    QList<Media*> findBest(const QString &search_term, MediaType = None, int count = 1, QList<Media*> *all = nullptr) const;
     QList<Media*> findMultiple(const QString &search_term, MediaType = None) const; // returns empty list if nothing was found
+                                                                                    // the results of recent searches are cached
 
     int count(MediaType = None) const; // Returns the number of [Media] objects of type [MediaType] in the model
 
@@ -73,18 +222,166 @@ public:
     Media *at(int pos, MediaType = None) const; // Returns [Media] at position [pos] in the list, returns a nullptr if out of bound
 
 private:
-    void iterateFilesystemHelper(const QStringList &nameFilters, MediaType);
-    void buildMediaList(const QStringList*, MediaType);
+    // changes of the library, computed in the background and applied by the model owner
+    struct LibraryDelta {
+        QStringList removed;  // relative paths
+        QList<Media*> added;  // new media objects, owned by the delta until they are applied
+        DirectoryState state; // directory state which matches the media list after the changes are applied,
+                              // empty for all but the last batch of a scan
+        QList<Media> updated; // tags, search paths and audio properties of existing media, matched by path
+    };
+
+    // compares the given subtrees with the directory state, queues the changes and updates the state
+    // requires the scan run mutex to be locked, the scan mutex is only locked for the MediaCache
+    void scanDirectories(const QStringList &dirs, const QStringList &modified);
+    void queueDelta(const LibraryDelta &delta);
+    void discardPendingUpdates();
+
+    static bool isSubdirectory(const QString &dir, const QString &parent);
+
+    // state which is the same for all files of a directory, built once per directory
+    struct DirectoryContext {
+        QString path;                    // directory part of the path without the deletion prefixes
+        QList<QStringList> searchPaths;  // SearchPathGen output for [path], one list per gen
+        bool hoisted = false;            // false if the whole path must be processed for every file
+    };
+
+    DirectoryContext directoryContext(const QString &dir) const;
+
+    void buildMediaList(const QStringList*, QList<Media*> *target);
+
+    // reads the tags of the given media using a pool of threads
+    static void readTags(const QList<Media*> &media);
+
+    // reads the tags of a single media, skips quarantined files and records the time it took
+    static void readTags(Media *media);
+    friend class TagsReaderWorker;
+
+    // adds artist, album and title to the search paths
+    static void appendTagsSearchPath(Media *media);
+
+    // builds the case-folded copy of the search paths, call this whenever the search paths changed
+    // in canonical search mode the SearchPathGens fold the search paths to a single form too
+    void foldSearchPaths(Media *media) const;
+    QString foldString(const QString &str) const;
+
+    // the SearchPathGens which fold the search paths and the search terms, none if canonical search is disabled
+    QList<SearchPathGen*> folding() const;
     void finalizeMediaList();
 
+    // incremental updates of the finalized media list
+    void removeMedia(const QStringList &paths);
+    void insertMedia(QList<Media*> &media);
+
+    // keeps the search index and the cached search results up to date after incremental changes
+    // [gone] media are about to be deleted or changed, [changed] media are new or got new search paths
+    void updateSearchIndex(const QSet<Media*> &gone, const QList<Media*> &changed);
+
+    void applyDefaultNameFilters();
+
+    // extension -> [MediaType] lookup, built once from the name filters before a scan
+    // filters which are not in the simple '*.ext' form are kept as wildcard patterns
+    void buildMediaTypeLookup();
+    MediaType mediaType(const QString &file) const;
+
     void moveInstrumentalTracksToBottom(); // feature: move [Instrumental] tracks to bottom of list, but keep original order
     void createSortedMediaList(); // copy pointers to a MediaType categorized media list map
 
+    static bool isInstrumental(const Media *media);
+
+    // trigram index over the folded search paths, built by finalizeMediaList()
+    // the document ids are stable (Media::searchId), new and changed media are appended with a new id
+    // and the ids of removed media are skipped; it is built again once most of its ids are dead
+    void buildSearchIndex() const;
+
+    // positions of the media which may match the search patterns, in list order
+    // returns false if the index can't narrow the search down (every media is a candidate)
+    bool candidateIds(const SearchKeys &search, QVector<int> *ids) const;
+
+    // results of recent findMultiple() calls, only valid while the generation didn't change
+    // incremental changes only drop the results which contain or would contain a changed media
+    struct QueryResult {
+        QueryResult(const SearchCursor &filter, MediaType type)
+            : filter(filter), type(type) {}
+
+        quint64 generation;
+        QList<Media*> media;
+
+        SearchCursor filter;
+        MediaType type;
+    };
+
+    // cache key of a search, the media type and the parsed search patterns
+    static QString queryKey(const SearchKeys &search, MediaType type);
+
+    // the cached results of the search, returns false if there are none (or they are outdated)
+    bool cachedQuery(const SearchKeys &search, MediaType type, QList<Media*> *media) const;
+
+    // search term filters |min and |max
+    static bool matchesDuration(const Media *media, const SearchKeys &search);
+
+    // order of the finalized media list: instrumental tracks last, than by type, than by path
+    static bool lessThan(const Media *m1, const Media *m2);
+
+    // replaces the directory state of the last walk, requires the scan run mutex to be locked
+    void commitDirectoryState(const DirectoryState &state);
+
+    // the application is exiting or a full scan is waiting for the running scan
+    bool scanCanceled() const;
+
     QMap<MediaType, QStringList> m_filters;
     QStringList m_prefixDeletionPatterns;
 
+    QHash<QString, MediaType> m_typeLookup;
+    QList<QPair<QRegExp, MediaType> > m_typeWildcards;
+
     QList<Media*> m_media;
     QMap<MediaType, QList<Media*> > m_media_sorted;
+    QMap<MediaType, QBitArray> m_typeBitmaps; // bit [i] is set if m_media[i] is of this type
+    QHash<QString, Media*> m_mediaByPath;
+
+    // increased whenever the whole media list is replaced
+    quint64 m_generation = 0;
+    mutable QCache<QString, QueryResult> m_queryCache;
+
+    mutable TrigramIndex m_searchIndex;
+    mutable bool m_searchIndexOutdated = true;
+    mutable QVector<int> m_searchPositions; // document id -> position in [m_media], -1 if the media is gone
+    mutable int m_searchDeadIds = 0;        // ids of removed and changed media which are still in the index
+
+    DirectoryState m_dirState;       // state of the last walk, ahead of the media list if changes are queued
+    QAtomicInt m_dirRevision;        // see directoriesRevision()
+    DirectoryState m_publishedState; // state which matches the media list, part of the snapshot
+
+    QString m_snapshotFile;
+    bool m_snapshotOutdated = false;
+
+    // serializes all filesystem scans, held for the whole scan
+    QMutex m_scanRunMutex;
+
+    // guards the directory state and the use of the MediaCache, held only for short moments
+    // the scanning thread reads [m_dirState] without it, all writers hold both mutexes
+    mutable QMutex m_scanMutex;
+
+    QMutex m_pendingMutex;
+    QList<LibraryDelta> m_pendingUpdates;
+
+    QAtomicInt m_scansCanceled;
+    QAtomicInt m_scanAbort; // a full scan is waiting for the running scan, see iterateFilesystem()
+    QAtomicInt m_scanning;
+    QAtomicInt m_scanDone;
+    QAtomicInt m_scanTotal;
+
+    bool m_canonicalSearch = false;
+
+    // copies of the media which are waiting for their tags or audio properties,
+    // see loadTags() and loadProperties(); the tags are read first, than the properties
+    bool m_lazyTags = false;
+    bool m_audioProperties = false;
+    mutable QMutex m_backgroundMutex;
+    QList<Media> m_untagged;
+    QList<Media> m_unprobed;
+
     QList<SearchPathGen*> m_searchPathGens;
 
     void deleteSearchPathGens();
@@ -7,6 +7,593 @@
 #include <taglib/wavfile.h>
 
 #include <QDebug>
+#include <QtEndian>
+#include <QTextCodec>
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// fields larger than this are skipped without reading them (embedded pictures, lyrics, ...)
+static const qint64 MaxFieldSize = 64 * 1024;
+
+// metadata blocks which are read into memory as a whole are small, anything larger is not what we are looking for
+static const qint64 MaxBlockSize = 1024 * 1024;
+
+// read-only file which is accessed using pread(), no buffering
+class RawFile
+{
+public:
+    RawFile(const QString &path)
+    {
+        this->m_fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+
+        struct stat st;
+        if (this->m_fd != -1 && ::fstat(this->m_fd, &st) == 0)
+            this->m_size = st.st_size;
+    }
+
+    ~RawFile()
+    {
+        if (this->m_fd != -1)
+            ::close(this->m_fd);
+    }
+
+    bool isOpen() const
+    {
+        return this->m_fd != -1;
+    }
+
+    qint64 size() const
+    {
+        return this->m_size;
+    }
+
+    // reads exactly [len] bytes at [pos], returns false if the file is too short
+    bool read(qint64 pos, void *data, qint64 len) const
+    {
+        if (pos < 0 || len < 0 || pos + len > this->m_size)
+            return false;
+
+        char *buf = static_cast<char*>(data);
+        while (len > 0)
+        {
+            ssize_t n = ::pread(this->m_fd, buf, len, pos);
+            if (n <= 0)
+                return false;
+
+            buf += n;
+            pos += n;
+            len -= n;
+        }
+
+        return true;
+    }
+
+    QByteArray read(qint64 pos, qint64 len) const
+    {
+        // the sizes come from the file, don't allocate anything for a broken one
+        if (pos < 0 || len < 0 || len > this->m_size - pos)
+            return QByteArray();
+
+        QByteArray data(len, Qt::Uninitialized);
+        if (!this->read(pos, data.data(), len))
+            return QByteArray();
+        return data;
+    }
+
+private:
+    int m_fd = -1;
+    qint64 m_size = 0;
+};
+
+// sequential reader for a byte range of a file
+class RangeReader
+{
+public:
+    RangeReader(const RawFile &file, qint64 pos, qint64 end)
+        : m_file(file),
+          m_pos(pos),
+          m_end(end)
+    {
+    }
+
+    // reads (or skips if [data] is a nullptr) the next [len] bytes
+    bool read(char *data, qint64 len)
+    {
+        if (this->m_pos + len > this->m_end)
+            return false;
+        if (data && !this->m_file.read(this->m_pos, data, len))
+            return false;
+
+        this->m_pos += len;
+        return true;
+    }
+
+private:
+    const RawFile &m_file;
+    qint64 m_pos;
+    qint64 m_end;
+};
+
+// sequential reader for a packet of an Ogg stream, the packet may span multiple pages
+class OggPacketReader
+{
+public:
+    OggPacketReader(const RawFile &file, qint64 pagePos, quint32 serial)
+        : m_file(file),
+          m_pagePos(pagePos),
+          m_serial(serial)
+    {
+    }
+
+    // reads (or skips if [data] is a nullptr) the next [len] bytes of the packet
+    bool read(char *data, qint64 len)
+    {
+        while (len > 0)
+        {
+            if (this->m_left == 0)
+            {
+                if (this->m_end || !this->nextSegments())
+                    return false;
+                continue;
+            }
+
+            qint64 n = qMin(len, this->m_left);
+            if (data)
+            {
+                if (!this->m_file.read(this->m_dataPos, data, n))
+                    return false;
+                data += n;
+            }
+
+            this->m_dataPos += n;
+            this->m_left -= n;
+            len -= n;
+        }
+
+        return true;
+    }
+
+private:
+    // continues with the following segments of the packet, until the packet or the page ends
+    bool nextSegments()
+    {
+        while (this->m_segment >= this->m_lacing.size())
+        {
+            if (!this->loadPage())
+                return false;
+        }
+
+        while (this->m_segment < this->m_lacing.size())
+        {
+            const uchar size = this->m_lacing.at(this->m_segment++);
+            this->m_left += size;
+
+            // a segment shorter than 255 bytes terminates the packet
+            if (size < 255)
+            {
+                this->m_end = true;
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    bool loadPage()
+    {
+        uchar header[27];
+        if (!this->m_file.read(this->m_pagePos, header, 27) ||
+            std::memcmp(header, "OggS", 4) != 0 ||
+            qFromLittleEndian<quint32>(header + 14) != this->m_serial)
+            return false;
+
+        const int segments = header[26];
+        this->m_lacing = this->m_file.read(this->m_pagePos + 27, segments);
+        if (this->m_lacing.size() != segments)
+            return false;
+
+        qint64 body = 0;
+        for (int i = 0; i < segments; i++)
+            body += static_cast<uchar>(this->m_lacing.at(i));
+
+        this->m_segment = 0;
+        this->m_dataPos = this->m_pagePos + 27 + segments;
+        this->m_pagePos = this->m_dataPos + body;
+        return true;
+    }
+
+    const RawFile &m_file;
+    qint64 m_pagePos;     // offset of the next page
+    quint32 m_serial;
+
+    QByteArray m_lacing;  // segment table of the current page
+    int m_segment = 0;    // next unread entry of the segment table
+    qint64 m_dataPos = 0; // offset of the next unread byte of the packet
+    qint64 m_left = 0;    // unread bytes until the current page or packet ends
+    bool m_end = false;   // the packet ends with the current segments
+};
+
+// multiple values of a field are separated by a space, same as taglib does it
+static void appendField(QString &field, const QString &value)
+{
+    if (value.isEmpty())
+        return;
+
+    if (field.isEmpty())
+        field = value;
+    else field.append(' ' + value);
+}
+
+// ID3v1 genres, referenced by number from ID3v2 and MP4 tags
+static const char *const Id3v1Genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+    "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+    "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "Alternative Rock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+    "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychedelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+    "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+    "Folk", "Folk-Rock", "National Folk", "Swing", "Fast-Fusion", "Bebop", "Latin", "Revival",
+    "Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock", "Psychedelic Rock", "Symphonic Rock", "Slow Rock",
+    "Big Band", "Chorus", "Easy Listening", "Acoustic", "Humour", "Speech", "Chanson", "Opera",
+    "Chamber Music", "Sonata", "Symphony", "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam",
+    "Club", "Tango", "Samba", "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul", "Freestyle",
+    "Duet", "Punk Rock", "Drum Solo", "A Cappella", "Euro-House", "Dance Hall"
+};
+
+// returns the genre name for the given number, or the number itself if it is unknown
+static QString id3v1Genre(int index)
+{
+    if (index >= 0 && index < int(sizeof(Id3v1Genres) / sizeof(Id3v1Genres[0])))
+        return QString::fromLatin1(Id3v1Genres[index]);
+    return QString::number(index);
+}
+
+// ID3v2 genre: "Pop", "13", "(13)" or "(13)Pop"
+static QString id3v2Genre(const QString &value)
+{
+    bool numeric = false;
+    int index = value.toInt(&numeric);
+    if (numeric)
+        return id3v1Genre(index);
+
+    if (value.startsWith('('))
+    {
+        int close = value.indexOf(')');
+        if (close > 1)
+        {
+            const QString refined = value.mid(close + 1);
+            if (!refined.isEmpty())
+                return refined;
+
+            index = value.mid(1, close - 1).toInt(&numeric);
+            if (numeric)
+                return id3v1Genre(index);
+        }
+    }
+
+    return value;
+}
+
+// ID3v2 integers which have the highest bit of every byte cleared
+static quint32 syncsafe(const uchar *data)
+{
+    return (quint32(data[0] & 0x7f) << 21) |
+           (quint32(data[1] & 0x7f) << 14) |
+           (quint32(data[2] & 0x7f) << 7) |
+            quint32(data[3] & 0x7f);
+}
+
+// size of the ID3v2 tag at the beginning of the file, 0 if there is none
+static qint64 id3v2TagSize(const RawFile &file)
+{
+    uchar header[10];
+    if (!file.read(0, header, 10) || std::memcmp(header, "ID3", 3) != 0)
+        return 0;
+
+    // the footer is only present in ID3v2.4
+    return 10 + syncsafe(header + 6) + ((header[5] & 0x10) ? 10 : 0);
+}
+
+// decodes the text of an ID3v2 text frame, multiple values are joined
+static QString id3v2Text(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return QString();
+
+    const char encoding = data.at(0);
+    QString text;
+
+    // ISO-8859-1 and UTF-8, values are separated by a single null byte
+    if (encoding == 0 || encoding == 3)
+    {
+        for (const QByteArray &value : data.mid(1).split('\0'))
+            appendField(text, encoding == 0 ? QString::fromLatin1(value) : QString::fromUtf8(value));
+        return text;
+    }
+
+    // UTF-16 with byte order mark or UTF-16BE, values are separated by two null bytes
+    if (encoding == 1 || encoding == 2)
+    {
+        bool little_endian = false;
+        bool value_start = true;
+        QString value;
+
+        for (int i = 1; i + 1 < data.size(); i += 2)
+        {
+            const uchar b1 = data.at(i);
+            const uchar b2 = data.at(i + 1);
+
+            // end of the value, every value of an UTF-16 string has its own byte order mark
+            if (b1 == 0 && b2 == 0)
+            {
+                appendField(text, value);
+                value.clear();
+                value_start = true;
+                continue;
+            }
+
+            if (value_start && encoding == 1)
+            {
+                value_start = false;
+                if (b1 == 0xff && b2 == 0xfe) { little_endian = true; continue; }
+                if (b1 == 0xfe && b2 == 0xff) { little_endian = false; continue; }
+            }
+
+            value.append(QChar(little_endian ? ushort(b1 | (b2 << 8)) : ushort((b1 << 8) | b2)));
+        }
+
+        appendField(text, value);
+        return text;
+    }
+
+    return QString();
+}
+
+// reads a vorbis comment block (used by flac, ogg vorbis and opus)
+template<typename Reader>
+static bool readVorbisComment(Reader &reader, MediaLibraryModel::MediaTags &tags)
+{
+    uchar length[4];
+
+    // vendor string
+    if (!reader.read(reinterpret_cast<char*>(length), 4) ||
+        !reader.read(nullptr, qFromLittleEndian<quint32>(length)))
+        return false;
+
+    if (!reader.read(reinterpret_cast<char*>(length), 4))
+        return false;
+
+    const quint32 count = qFromLittleEndian<quint32>(length);
+    for (quint32 i = 0; i < count; i++)
+    {
+        if (!reader.read(reinterpret_cast<char*>(length), 4))
+            return false;
+
+        const quint32 size = qFromLittleEndian<quint32>(length);
+
+        // only short fields can be one of the wanted ones, skip pictures and such
+        if (size > MaxFieldSize)
+        {
+            if (!reader.read(nullptr, size))
+                return false;
+            continue;
+        }
+
+        QByteArray comment(size, Qt::Uninitialized);
+        if (!reader.read(comment.data(), size))
+            return false;
+
+        int sep = comment.indexOf('=');
+        if (sep == -1)
+            continue;
+
+        const QByteArray key = comment.left(sep).toUpper();
+        const QString value = QString::fromUtf8(comment.constData() + sep + 1, comment.size() - sep - 1);
+
+        if (key == "ARTIST")
+            appendField(tags.artist, value);
+        else if (key == "ALBUM")
+            appendField(tags.album, value);
+        else if (key == "TITLE")
+            appendField(tags.title, value);
+        else if (key == "GENRE")
+            appendField(tags.genre, value);
+    }
+
+    return true;
+}
+
+// INFO strings are supposed to be ASCII, but UTF-8 is hacked in quite often
+static QString riffText(const QByteArray &data)
+{
+    int len = data.indexOf('\0');
+    if (len == -1)
+        len = data.size();
+
+    QTextCodec::ConverterState state;
+    const QString text = QTextCodec::codecForName("UTF-8")->toUnicode(data.constData(), len, &state);
+    if (state.invalidChars == 0)
+        return text;
+
+    return QString::fromLatin1(data.constData(), len);
+}
+
+// Matroska element ids
+static const quint32 EbmlHeaderId = 0x1A45DFA3;
+static const quint32 SegmentId = 0x18538067;
+static const quint32 SeekHeadId = 0x114D9B74;
+static const quint32 SeekId = 0x4DBB;
+static const quint32 SeekIdId = 0x53AB;
+static const quint32 SeekPositionId = 0x53AC;
+static const quint32 InfoId = 0x1549A966;
+static const quint32 TitleId = 0x7BA9;
+static const quint32 ClusterId = 0x1F43B675;
+static const quint32 TagsId = 0x1254C367;
+static const quint32 TagId = 0x7373;
+static const quint32 TargetsId = 0x63C0;
+static const quint32 TargetTypeValueId = 0x68CA;
+static const quint32 SimpleTagId = 0x67C8;
+static const quint32 TagNameId = 0x45A3;
+static const quint32 TagStringId = 0x4487;
+
+// EBML element header: variable length id and data size
+struct EbmlElement {
+    quint32 id = 0;
+    qint64 size = 0;    // -1 if unknown
+    int headerSize = 0;
+};
+
+static bool readEbmlHeader(const uchar *data, qint64 len, EbmlElement *element)
+{
+    if (len < 1)
+        return false;
+
+    // the length marker is part of the id
+    int id_len = 1;
+    uchar mask = 0x80;
+    while (id_len <= 4 && !(data[0] & mask))
+    {
+        id_len++;
+        mask >>= 1;
+    }
+
+    if (id_len > 4 || len < id_len + 1)
+        return false;
+
+    quint32 id = 0;
+    for (int i = 0; i < id_len; i++)
+        id = (id << 8) | data[i];
+
+    // the length marker is removed from the size, all bits set means unknown size
+    const uchar first = data[id_len];
+    int size_len = 1;
+    mask = 0x80;
+    while (size_len <= 8 && !(first & mask))
+    {
+        size_len++;
+        mask >>= 1;
+    }
+
+    if (size_len > 8 || len < id_len + size_len)
+        return false;
+
+    quint64 size = first & (mask - 1);
+    bool unknown = size == quint64(mask - 1);
+    for (int i = 1; i < size_len; i++)
+    {
+        size = (size << 8) | data[id_len + i];
+        if (data[id_len + i] != 0xff)
+            unknown = false;
+    }
+
+    element->id = id;
+    element->size = unknown ? -1 : qint64(size);
+    element->headerSize = id_len + size_len;
+    return true;
+}
+
+static bool readEbmlHeader(const RawFile &file, qint64 pos, EbmlElement *element)
+{
+    uchar header[12];
+    const qint64 len = qMin<qint64>(sizeof(header), file.size() - pos);
+    if (len <= 0 || !file.read(pos, header, len))
+        return false;
+
+    return readEbmlHeader(header, len, element);
+}
+
+// reads the data of the element at [pos], returns an empty array if it is too large
+static QByteArray readEbmlElement(const RawFile &file, qint64 pos, quint32 id)
+{
+    EbmlElement element;
+    if (!readEbmlHeader(file, pos, &element) || element.id != id ||
+        element.size < 0 || element.size > MaxBlockSize)
+        return QByteArray();
+
+    return file.read(pos + element.headerSize, element.size);
+}
+
+// calls [func] with the id and data of every child element in [data]
+template<typename Func>
+static void forEachEbmlChild(const QByteArray &data, Func func)
+{
+    const uchar *ptr = reinterpret_cast<const uchar*>(data.constData());
+    qint64 pos = 0;
+
+    EbmlElement element;
+    while (readEbmlHeader(ptr + pos, data.size() - pos, &element))
+    {
+        const qint64 start = pos + element.headerSize;
+        if (element.size < 0 || start + element.size > data.size())
+            break;
+
+        func(element.id, QByteArray::fromRawData(data.constData() + start, element.size));
+        pos = start + element.size;
+    }
+}
+
+static quint64 ebmlUInt(const QByteArray &data)
+{
+    quint64 value = 0;
+    for (int i = 0; i < data.size() && i < 8; i++)
+        value = (value << 8) | static_cast<uchar>(data.at(i));
+    return value;
+}
+
+static QString ebmlString(const QByteArray &data)
+{
+    // strings may be padded with null bytes
+    int len = data.indexOf('\0');
+    return QString::fromUtf8(data.constData(), len == -1 ? data.size() : len);
+}
+
+// looks for a child atom of the given type in [pos, end), returns the range of its contents
+static bool findMp4Atom(const RawFile &file, qint64 pos, qint64 end, const char *type, qint64 *start, qint64 *stop)
+{
+    while (pos + 8 <= end)
+    {
+        uchar header[16];
+        if (!file.read(pos, header, 8))
+            return false;
+
+        qint64 size = qFromBigEndian<quint32>(header);
+        qint64 header_size = 8;
+
+        // 64-bit size follows the type
+        if (size == 1)
+        {
+            if (!file.read(pos + 8, header + 8, 8))
+                return false;
+            size = qFromBigEndian<quint64>(header + 8);
+            header_size = 16;
+        }
+
+        // the atom extends to the end of its parent
+        else if (size == 0)
+            size = end - pos;
+
+        if (size < header_size || pos + size > end)
+            return false;
+
+        if (std::memcmp(header + 4, type, 4) == 0)
+        {
+            *start = pos + header_size;
+            *stop = pos + size;
+            return true;
+        }
+
+        pos += size;
+    }
+
+    return false;
+}
 
 MediaTagsReader::MediaTagsReader(MediaLibraryModel::Media *media)
 {
@@ -23,13 +610,15 @@ MediaTagsReader::MediaTagsReader(MediaLibraryModel::Media *media)
     // RIFF INFO Tags
     if (this->ptr_media->fileformat == "wav")
     {
-        if (!this->readWavFile())
+        if (!this->readRiffInfoTags() && !this->readWavFile())
             (void) this->readTags();
     }
 
     // Other Tag Formats
+    // the native readers handle the most common formats without taglib
     else {
-        (void) this->readTags();
+        if (!this->readNativeTags())
+            (void) this->readTags();
     }
 }
 
@@ -39,6 +628,37 @@ MediaTagsReader::~MediaTagsReader()
     this->ptr_media = nullptr;
 }
 
+bool MediaTagsReader::failed() const
+{
+    return this->m_failed;
+}
+
+bool MediaTagsReader::readAudioProperties(MediaLibraryModel::Media *media)
+{
+    if (!media)
+        return false;
+
+    media->properties = MediaLibraryModel::MediaProperties();
+    media->properties.probed = true;
+
+    // don't open a non-existent file, taglib crashes otherwise...
+    if (!QFile(media->path).exists())
+        return false;
+
+    // the fast mode estimates the duration of VBR files instead of reading the whole stream
+    TagLib::FileRef m_fileRef(qUtf8Printable(media->path), true, TagLib::AudioProperties::Fast);
+    if (m_fileRef.isNull() || !m_fileRef.audioProperties())
+        return false;
+
+    const TagLib::AudioProperties *properties = m_fileRef.audioProperties();
+    media->properties.duration = properties->length() > 0 ? properties->length() : -1;
+    media->properties.bitrate = properties->bitrate();
+    media->properties.sampleRate = properties->sampleRate();
+    media->properties.channels = properties->channels();
+
+    return true;
+}
+
 bool MediaTagsReader::readWavFile()
 {
     TagLib::RIFF::WAV::File m_wavFile(qUtf8Printable(this->ptr_media->path), false); // don't read audio props
@@ -74,7 +694,12 @@ bool MediaTagsReader::readTags()
 {
     TagLib::FileRef m_fileRef(qUtf8Printable(this->ptr_media->path), false); // don't read audio props
 
-    if (!m_fileRef.isNull())
+    // taglib is the last resort, nobody can read this file
+    // formats which taglib doesn't know at all are not an error (videos, ...)
+    if (m_fileRef.isNull())
+        this->m_failed = TagLib::FileRef::defaultFileExtensions().contains(this->ptr_media->fileformat.toUtf8().constData());
+
+    else
     {
         if (!m_fileRef.tag()->isEmpty())
         {
@@ -91,27 +716,505 @@ bool MediaTagsReader::readTags()
     return false;
 }
 
+bool MediaTagsReader::readNativeTags()
+{
+    const QString &format = this->ptr_media->fileformat;
+
+    if (format == "mp3")
+        return this->readId3v2Tags();
+    else if (format == "flac")
+        return this->readFlacTags();
+    else if (format == "ogg" || format == "oga" || format == "opus")
+        return this->readOggTags();
+    else if (format == "m4a" || format == "m4b")
+        return this->readMp4Tags();
+    else if (format == "mka" || format == "mkv" || format == "webm")
+        return this->readMatroskaMetadata();
+
+    return false;
+}
+
+bool MediaTagsReader::readId3v2Tags()
+{
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    uchar header[10];
+    if (!file.read(0, header, 10) || std::memcmp(header, "ID3", 3) != 0)
+        return false;
+
+    const int version = header[3];
+    const uchar flags = header[5];
+
+    // unsynchronisation and compression change the frame layout, taglib knows how to deal with it
+    if (version < 2 || version > 4 || (flags & 0x80) || (version == 2 && (flags & 0x40)))
+        return false;
+
+    const qint64 end = 10 + syncsafe(header + 6);
+    qint64 pos = 10;
+
+    // skip the extended header
+    if (version > 2 && (flags & 0x40))
+    {
+        uchar size[4];
+        if (!file.read(pos, size, 4))
+            return false;
+        pos += version == 3 ? 4 + qFromBigEndian<quint32>(size) : syncsafe(size);
+    }
+
+    const int frame_header_size = version == 2 ? 6 : 10;
+    const int id_size = version == 2 ? 3 : 4;
+
+    MediaLibraryModel::MediaTags tags;
+
+    while (pos + frame_header_size <= end)
+    {
+        uchar frame[10];
+        if (!file.read(pos, frame, frame_header_size))
+            return false;
+
+        // padding
+        if (frame[0] == 0)
+            break;
+
+        // garbage, maybe a broken frame size
+        for (int i = 0; i < id_size; i++)
+        {
+            if (!((frame[i] >= 'A' && frame[i] <= 'Z') || (frame[i] >= '0' && frame[i] <= '9')))
+                return false;
+        }
+
+        const QByteArray id(reinterpret_cast<const char*>(frame), id_size);
+        qint64 size;
+        quint16 frame_flags = 0;
+
+        if (version == 2)
+            size = (frame[3] << 16) | (frame[4] << 8) | frame[5];
+        else
+        {
+            size = version == 4 ? syncsafe(frame + 4) : qFromBigEndian<quint32>(frame + 4);
+            frame_flags = qFromBigEndian<quint16>(frame + 8);
+        }
+
+        pos += frame_header_size;
+        if (pos + size > end)
+            return false;
+
+        QString *field = nullptr;
+        if (id == "TPE1" || id == "TP1")
+            field = &tags.artist;
+        else if (id == "TALB" || id == "TAL")
+            field = &tags.album;
+        else if (id == "TIT2" || id == "TT2")
+            field = &tags.title;
+        else if (id == "TCON" || id == "TCO")
+            field = &tags.genre;
+
+        if (field && size > 0 && size <= MaxFieldSize)
+        {
+            // compressed, encrypted or unsynchronised frames
+            if ((version == 3 && (frame_flags & 0x00c0)) || (version == 4 && (frame_flags & 0x000e)))
+                return false;
+
+            // the data length indicator precedes the frame data
+            qint64 data_pos = pos;
+            qint64 data_size = size;
+            if (version == 4 && (frame_flags & 0x0001))
+            {
+                if (size < 4)
+                    return false;
+
+                data_pos += 4;
+                data_size -= 4;
+            }
+
+            const QString text = id3v2Text(file.read(data_pos, data_size));
+            appendField(*field, field == &tags.genre ? id3v2Genre(text) : text);
+        }
+
+        pos += size;
+    }
+
+    return this->applyTags(tags);
+}
+
+bool MediaTagsReader::readFlacTags()
+{
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    // some taggers put an ID3v2 tag in front of the stream
+    qint64 pos = id3v2TagSize(file);
+
+    char magic[4];
+    if (!file.read(pos, magic, 4) || std::memcmp(magic, "fLaC", 4) != 0)
+        return false;
+    pos += 4;
+
+    // metadata blocks, the pictures have their own blocks and are skipped
+    while (true)
+    {
+        uchar header[4];
+        if (!file.read(pos, header, 4))
+            return false;
+
+        const bool last = header[0] & 0x80;
+        const int type = header[0] & 0x7f;
+        const qint64 size = (header[1] << 16) | (header[2] << 8) | header[3];
+
+        pos += 4;
+
+        if (type == 4)
+        {
+            MediaLibraryModel::MediaTags tags;
+            RangeReader reader(file, pos, pos + size);
+            if (!readVorbisComment(reader, tags))
+                return false;
+
+            return this->applyTags(tags);
+        }
+
+        if (last || type == 127)
+            return false;
+
+        pos += size;
+    }
+}
+
+bool MediaTagsReader::readOggTags()
+{
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    // the first page contains the identification header only
+    uchar header[27];
+    if (!file.read(0, header, 27) || std::memcmp(header, "OggS", 4) != 0)
+        return false;
+
+    const quint32 serial = qFromLittleEndian<quint32>(header + 14);
+    const int segments = header[26];
+
+    const QByteArray lacing = file.read(27, segments);
+    if (lacing.size() != segments)
+        return false;
+
+    qint64 body = 0;
+    for (int i = 0; i < segments; i++)
+        body += static_cast<uchar>(lacing.at(i));
+
+    char id[8];
+    if (!file.read(27 + segments, id, 8))
+        return false;
+
+    // the comment header starts on the second page
+    OggPacketReader reader(file, 27 + segments + body, serial);
+    char magic[8];
+
+    if (std::memcmp(id, "\x01vorbis", 7) == 0)
+    {
+        if (!reader.read(magic, 7) || std::memcmp(magic, "\x03vorbis", 7) != 0)
+            return false;
+    }
+
+    else if (std::memcmp(id, "OpusHead", 8) == 0)
+    {
+        if (!reader.read(magic, 8) || std::memcmp(magic, "OpusTags", 8) != 0)
+            return false;
+    }
+
+    else return false;
+
+    MediaLibraryModel::MediaTags tags;
+    if (!readVorbisComment(reader, tags))
+        return false;
+
+    return this->applyTags(tags);
+}
+
+bool MediaTagsReader::readMp4Tags()
+{
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    // moov > udta > meta > ilst, the media data is skipped using the atom sizes
+    qint64 start = 0, end = file.size();
+    if (!findMp4Atom(file, start, end, "moov", &start, &end) ||
+        !findMp4Atom(file, start, end, "udta", &start, &end) ||
+        !findMp4Atom(file, start, end, "meta", &start, &end) ||
+        !findMp4Atom(file, start + 4, end, "ilst", &start, &end)) // meta has version and flags
+        return false;
+
+    MediaLibraryModel::MediaTags tags;
+    qint64 pos = start;
+
+    while (pos + 8 <= end)
+    {
+        uchar header[8];
+        if (!file.read(pos, header, 8))
+            return false;
+
+        const qint64 size = qFromBigEndian<quint32>(header);
+        if (size < 8 || pos + size > end)
+            return false;
+
+        const QByteArray type(reinterpret_cast<const char*>(header + 4), 4);
+
+        QString *field = nullptr;
+        if (type == "\xa9" "ART")
+            field = &tags.artist;
+        else if (type == "\xa9" "alb")
+            field = &tags.album;
+        else if (type == "\xa9" "nam")
+            field = &tags.title;
+        else if (type == "\xa9" "gen" || type == "gnre")
+            field = &tags.genre;
+
+        // every value is stored in its own data atom: type, locale, value
+        qint64 data_start = pos + 8, data_end = 0;
+        while (field && size <= MaxFieldSize && findMp4Atom(file, data_start, pos + size, "data", &data_start, &data_end))
+        {
+            const QByteArray data = file.read(data_start, data_end - data_start);
+            if (data.size() < 8)
+                break;
+
+            // genre as ID3v1 number + 1
+            if (type == "gnre")
+            {
+                if (data.size() >= 10)
+                    appendField(*field, id3v1Genre(qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(data.constData() + 8)) - 1));
+            }
+
+            else appendField(*field, QString::fromUtf8(data.constData() + 8, data.size() - 8));
+
+            data_start = data_end;
+        }
+
+        pos += size;
+    }
+
+    return this->applyTags(tags);
+}
+
+bool MediaTagsReader::applyTags(const MediaLibraryModel::MediaTags &tags)
+{
+    if (tags.artist.isEmpty() &&
+        tags.album.isEmpty() &&
+        tags.title.isEmpty())
+        return false;
+
+    this->ptr_media->tags = tags;
+    return true;
+}
+
 bool MediaTagsReader::readRiffInfoTags()
 {
-    /*TagLib::RIFF::WAV::File m_wavFile(qUtf8Printable(this->ptr_media->path), false);
-    for (const auto &s : m_wavFile.InfoTag()->fieldListMap())
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    uchar header[12];
+    if (!file.read(0, header, 12) ||
+        std::memcmp(header, "RIFF", 4) != 0 ||
+        std::memcmp(header + 8, "WAVE", 4) != 0)
+        return false;
+
+    const qint64 end = qMin(file.size(), 8 + qint64(qFromLittleEndian<quint32>(header + 4)));
+    qint64 pos = 12;
+
+    // walk the chunk headers, the audio data is skipped by its size
+    while (pos + 8 <= end)
     {
-        // trying out something
-        //qDebug() << "8 bit (unicode)       -> " << s.second.to8Bit(true).c_str();
-        //qDebug() << "8 bit (ascii)         -> " << s.second.to8Bit(false).c_str();
-        //qDebug() << "C string (unicode)    -> " << s.second.toCString(true);
-        //qDebug() << "C string (ascii)      -> " << s.second.toCString(false);
-        //qDebug() << "C wstring (unicode)   -> " << s.second.toCWString();
-        //qDebug() << "C++ wstring (unicode) -> " << s.second.toWString().c_str();
+        uchar chunk[12];
+        if (!file.read(pos, chunk, qMin<qint64>(12, end - pos)))
+            return false;
+
+        const qint64 size = qFromLittleEndian<quint32>(chunk + 4);
+
+        if (std::memcmp(chunk, "LIST", 4) == 0 && pos + 12 <= end && std::memcmp(chunk + 8, "INFO", 4) == 0)
+        {
+            if (size < 4 || size > MaxBlockSize)
+                return false;
+
+            const QByteArray info = file.read(pos + 12, qMin(size - 4, end - pos - 12));
+            MediaLibraryModel::MediaTags tags;
+
+            // sub-chunks: id, size, null-terminated string, padded to an even size
+            // the sub-chunk size is untrusted, compare in 64 bit
+            int i = 0;
+            while (i + 8 <= info.size())
+            {
+                const char *id = info.constData() + i;
+                const qint64 len = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(id + 4));
+                if (qint64(i) + 8 + len > info.size())
+                    break;
+
+                const QByteArray value = QByteArray::fromRawData(id + 8, int(len));
+
+                if (std::memcmp(id, "IART", 4) == 0)
+                    tags.artist = riffText(value);
+                else if (std::memcmp(id, "INAM", 4) == 0)
+                    tags.title = riffText(value);
+                else if (std::memcmp(id, "IPRD", 4) == 0)
+                    tags.album = riffText(value);
+                else if (std::memcmp(id, "IGNR", 4) == 0)
+                    tags.genre = riffText(value);
+
+                i += 8 + int(len) + int(len & 1);
+            }
+
+            return this->applyTags(tags);
+        }
+
+        pos += 8 + size + (size & 1);
     }
-    */
 
-    qWarning() << "MediaTagsReader: readRiffInfoTags() is a stub";
     return false;
 }
 
 bool MediaTagsReader::readMatroskaMetadata()
 {
-    qWarning() << "MediaTagsReader: readMatroskaMetadata() is a stub";
-    return false;
+    RawFile file(this->ptr_media->path);
+    if (!file.isOpen())
+        return false;
+
+    EbmlElement element;
+    if (!readEbmlHeader(file, 0, &element) || element.id != EbmlHeaderId || element.size < 0)
+        return false;
+
+    qint64 pos = element.headerSize + element.size;
+    if (!readEbmlHeader(file, pos, &element) || element.id != SegmentId)
+        return false;
+
+    // all positions in the seek heads are relative to the segment data
+    const qint64 segment = pos + element.headerSize;
+    const qint64 segment_end = element.size == -1 ? file.size() : qMin(file.size(), segment + element.size);
+
+    qint64 info_pos = -1, tags_pos = -1;
+    QList<qint64> seek_heads;
+
+    // top level elements in front of the media data, only the headers are read
+    pos = segment;
+    while (pos < segment_end && readEbmlHeader(file, pos, &element) && element.size != -1 && element.id != ClusterId)
+    {
+        if (element.id == SeekHeadId)
+            seek_heads.append(pos);
+        else if (element.id == InfoId)
+            info_pos = pos;
+        else if (element.id == TagsId)
+            tags_pos = pos;
+
+        pos += element.headerSize + element.size;
+    }
+
+    // the tags are usually written behind the clusters, the seek heads know where they are
+    // a seek head may point to another seek head, don't follow them forever
+    for (int i = 0; i < seek_heads.size() && i < 4; i++)
+    {
+        forEachEbmlChild(readEbmlElement(file, seek_heads.at(i), SeekHeadId), [&](quint32 id, const QByteArray &seek) {
+            if (id != SeekId)
+                return;
+
+            quint32 target = 0;
+            qint64 target_pos = -1;
+
+            forEachEbmlChild(seek, [&](quint32 id, const QByteArray &data) {
+                if (id == SeekIdId)
+                    target = quint32(ebmlUInt(data));
+                else if (id == SeekPositionId)
+                    target_pos = segment + qint64(ebmlUInt(data));
+            });
+
+            if (target_pos < segment || target_pos >= segment_end)
+                return;
+
+            if (target == InfoId && info_pos == -1)
+                info_pos = target_pos;
+            else if (target == TagsId && tags_pos == -1)
+                tags_pos = target_pos;
+            else if (target == SeekHeadId && !seek_heads.contains(target_pos))
+                seek_heads.append(target_pos);
+        });
+    }
+
+    // segment title
+    QString segment_title;
+    if (info_pos != -1)
+    {
+        forEachEbmlChild(readEbmlElement(file, info_pos, InfoId), [&](quint32 id, const QByteArray &data) {
+            if (id == TitleId)
+                segment_title = ebmlString(data);
+        });
+    }
+
+    // tags of the whole file (album, movie: target type 50) and of the track (target type 30)
+    QString artist[2], title[2], album, genre;
+    if (tags_pos != -1)
+    {
+        forEachEbmlChild(readEbmlElement(file, tags_pos, TagsId), [&](quint32 id, const QByteArray &tag) {
+            if (id != TagId)
+                return;
+
+            quint64 target_type = 50;
+            forEachEbmlChild(tag, [&](quint32 id, const QByteArray &targets) {
+                if (id != TargetsId)
+                    return;
+                forEachEbmlChild(targets, [&](quint32 id, const QByteArray &data) {
+                    if (id == TargetTypeValueId)
+                        target_type = ebmlUInt(data);
+                });
+            });
+
+            const int level = target_type < 50 ? 1 : 0;
+
+            forEachEbmlChild(tag, [&](quint32 id, const QByteArray &simple_tag) {
+                if (id != SimpleTagId)
+                    return;
+
+                QString name, value;
+                forEachEbmlChild(simple_tag, [&](quint32 id, const QByteArray &data) {
+                    if (id == TagNameId)
+                        name = ebmlString(data).toUpper();
+                    else if (id == TagStringId)
+                        value = ebmlString(data);
+                });
+
+                // the same tag may be present in multiple languages, the first one wins
+                QString *field = nullptr;
+                if (name == "ARTIST")
+                    field = &artist[level];
+                else if (name == "TITLE")
+                    field = &title[level];
+                else if (name == "ALBUM")
+                    field = &album;
+                else if (name == "GENRE")
+                    field = &genre;
+
+                if (field && field->isEmpty())
+                    *field = value;
+            });
+        });
+    }
+
+    MediaLibraryModel::MediaTags tags;
+    tags.artist = artist[1].isEmpty() ? artist[0] : artist[1];
+    tags.genre = genre;
+
+    // a track title makes the title of the whole file the album title
+    if (!title[1].isEmpty())
+    {
+        tags.title = title[1];
+        tags.album = title[0].isEmpty() ? album : title[0];
+    }
+
+    else
+    {
+        tags.title = title[0].isEmpty() ? segment_title : title[0];
+        tags.album = album;
+    }
+
+    return this->applyTags(tags);
 }
@@ -11,6 +11,13 @@ public:
     MediaTagsReader(MediaLibraryModel::Media *media);
     ~MediaTagsReader();
 
+    // reads duration, bitrate, sample rate and channels into the [Media] object using taglib
+    // the media is marked as probed even if the properties can't be read
+    static bool readAudioProperties(MediaLibraryModel::Media *media);
+
+    // true if the file couldn't be opened by any of the readers (broken or unsupported file)
+    bool failed() const;
+
 private:
 
     // for WAV files
@@ -21,9 +28,29 @@ private:
     bool readTags();
 
 
+//=====================//
+/* native tag readers  */
+//=====================//
+
+    // fast path for the most common formats, only the tag headers are read from the file
+    // large fields like embedded pictures are skipped without reading them
+    // returns false if the file can't be handled, the caller falls back to taglib than
+    bool readNativeTags();
+
+    bool readId3v2Tags();  // mp3
+    bool readFlacTags();   // flac, vorbis comments
+    bool readOggTags();    // ogg vorbis and opus, vorbis comments
+    bool readMp4Tags();    // m4a, ilst atoms
+
+    // stores the tags in the media object, returns false if artist, album and title are empty
+    bool applyTags(const MediaLibraryModel::MediaTags &tags);
+
+
     // pointer to the given media object
     MediaLibraryModel::Media *ptr_media;
 
+    bool m_failed = false;
+
 
 //==========================//
 /* experimental tag readers */
@@ -35,6 +62,7 @@ private:
     bool readRiffInfoTags();
 
     // read matroska metadata (for MKA and MKV containers)
+    // follows the seek heads to the Info and Tags elements, the clusters (media data) are never read
     bool readMatroskaMetadata();
 };
 
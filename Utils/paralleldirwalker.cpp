@@ -0,0 +1,482 @@
+#include "paralleldirwalker.hpp"
+
+#include <QFile>
+#include <QDateTime>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// every open directory costs a file descriptor, deeper directories are opened by their path beyond that
+static const int MaxOpenDirectories = 256;
+
+// layout of the records returned by the getdents64 syscall
+struct LinuxDirent64 {
+    quint64        d_ino;
+    qint64         d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1];
+};
+#endif
+
+class ParallelDirWalker::Worker : public QRunnable
+{
+public:
+    Worker(ParallelDirWalker *walker, int id)
+        : ptr_walker(walker),
+          m_id(id)
+    {
+    }
+
+    void run()
+    {
+        // private copies of the wildcard name filters
+        QList<QRegExp> wildcards;
+        for (const QString &w : this->ptr_walker->m_wildcards)
+            wildcards.append(QRegExp(w, Qt::CaseInsensitive, QRegExp::Wildcard));
+
+        Task task;
+
+        // own work first, than steal from the others, than sleep until new work is queued
+        while (this->ptr_walker->pop(this->m_id, task) ||
+               this->ptr_walker->steal(this->m_id, task) ||
+               this->ptr_walker->wait(this->m_id, task))
+        {
+            this->ptr_walker->readDirectory(this->m_id, task, wildcards);
+            this->ptr_walker->finish();
+
+            // release the parent directory as soon as possible
+            task = Task();
+        }
+    }
+
+private:
+    ParallelDirWalker *ptr_walker;
+    int m_id;
+};
+
+ParallelDirWalker::Node::~Node()
+{
+#ifdef Q_OS_LINUX
+    if (this->fd != -1)
+    {
+        ::close(this->fd);
+        (void) this->ptr_open->deref();
+    }
+#endif
+}
+
+ParallelDirWalker::ParallelDirWalker(const QString &rootPath, const QStringList &nameFilters, int threads)
+{
+    this->m_root = QFile::encodeName(rootPath);
+
+    // network mounts are latency bound, use more threads than cores
+    this->m_threads = threads > 0 ? threads : qMax(4, QThread::idealThreadCount() * 2);
+
+    for (int i = 0; i < this->m_threads; i++)
+    {
+        this->m_queues.append(new TaskQueue);
+        this->m_results.append(new QStringList);
+        this->m_states.append(new DirectoryState);
+        this->m_changed.append(new QStringList);
+    }
+
+    // split the name filters into simple extensions and real wildcards
+    static const QRegExp wildcardChars("[\\*\\?\\[\\.]");
+
+    this->m_matchAll = nameFilters.isEmpty();
+
+    for (const QString &filter : nameFilters)
+    {
+        QString ext = filter.mid(2).toLower();
+
+        bool ascii = true;
+        for (const QChar &c : ext)
+            if (c.unicode() > 0x7f)
+                ascii = false;
+
+        if (filter.startsWith("*.") && !ext.isEmpty() && ascii && !ext.contains(wildcardChars))
+            this->m_extensions.insert(ext.toLatin1());
+        else this->m_wildcards.append(filter);
+
+        ext.clear();
+    }
+}
+
+ParallelDirWalker::~ParallelDirWalker()
+{
+    for (TaskQueue *queue : this->m_queues)
+        delete queue;
+    this->m_queues.clear();
+
+    for (QStringList *results : this->m_results)
+        delete results;
+    this->m_results.clear();
+
+    for (DirectoryState *state : this->m_states)
+        delete state;
+    this->m_states.clear();
+
+    for (QStringList *changed : this->m_changed)
+        delete changed;
+    this->m_changed.clear();
+
+    this->ptr_previous = nullptr;
+
+    this->m_extensions.clear();
+    this->m_wildcards.clear();
+}
+
+bool ParallelDirWalker::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ParallelDirWalker::setPreviousState(const DirectoryState *state)
+{
+    this->ptr_previous = state;
+}
+
+void ParallelDirWalker::walk()
+{
+    this->walk(QList<QByteArray>() << QByteArray());
+}
+
+void ParallelDirWalker::walk(const QList<QByteArray> &startDirs)
+{
+    for (QStringList *results : this->m_results)
+        results->clear();
+    for (DirectoryState *state : this->m_states)
+        state->clear();
+    for (QStringList *changed : this->m_changed)
+        changed->clear();
+
+    this->m_walkStarted = QDateTime::currentMSecsSinceEpoch() * Q_INT64_C(1000000);
+
+#ifdef Q_OS_LINUX
+    // the start directories are opened relative to the root directory
+    this->m_rootFd = ::open(this->m_root.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (this->m_rootFd == -1)
+        return;
+#endif
+
+    // the start directories are the first tasks, spread them over all workers
+    for (int i = 0; i < startDirs.size(); i++)
+    {
+        Task task;
+        task.dir = startDirs.at(i);
+        this->push(i % this->m_threads, task);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(this->m_threads);
+
+    for (int i = 0; i < this->m_threads; i++)
+        pool.start(new Worker(this, i));
+
+    pool.waitForDone();
+
+#ifdef Q_OS_LINUX
+    ::close(this->m_rootFd);
+    this->m_rootFd = -1;
+#endif
+}
+
+QStringList ParallelDirWalker::files() const
+{
+    QStringList files;
+
+    for (const QStringList *results : this->m_results)
+        files.append(*results);
+
+    return files;
+}
+
+ParallelDirWalker::DirectoryState ParallelDirWalker::state() const
+{
+    DirectoryState state;
+
+    for (const DirectoryState *s : this->m_states)
+    {
+        for (DirectoryState::const_iterator it = s->constBegin(); it != s->constEnd(); ++it)
+            state.insert(it.key(), it.value());
+    }
+
+    return state;
+}
+
+QStringList ParallelDirWalker::changedDirectories() const
+{
+    QStringList changed;
+
+    for (const QStringList *c : this->m_changed)
+        changed.append(*c);
+
+    return changed;
+}
+
+void ParallelDirWalker::push(int worker, const Task &task)
+{
+    // count the task before it becomes visible to other workers
+    (void) this->m_pending.ref();
+
+    {
+        TaskQueue *queue = this->m_queues.at(worker);
+        QMutexLocker lock(&queue->mutex);
+        queue->tasks.append(task);
+    }
+
+    QMutexLocker lock(&this->m_idleMutex);
+    if (this->m_waiting > 0)
+        this->m_idle.wakeOne();
+}
+
+bool ParallelDirWalker::pop(int worker, Task &task)
+{
+    // newest task first, stays close to the directory we just read
+    TaskQueue *queue = this->m_queues.at(worker);
+    QMutexLocker lock(&queue->mutex);
+
+    if (queue->tasks.isEmpty())
+        return false;
+
+    task = queue->tasks.takeLast();
+    return true;
+}
+
+bool ParallelDirWalker::steal(int worker, Task &task)
+{
+    // oldest task of another worker, usually the biggest subtree
+    for (int i = 1; i < this->m_threads; i++)
+    {
+        TaskQueue *queue = this->m_queues.at((worker + i) % this->m_threads);
+        QMutexLocker lock(&queue->mutex);
+
+        if (!queue->tasks.isEmpty())
+        {
+            task = queue->tasks.takeFirst();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ParallelDirWalker::wait(int worker, Task &task)
+{
+    QMutexLocker lock(&this->m_idleMutex);
+
+    while (true)
+    {
+        // nothing queued and nothing running, the walk is finished
+        if (this->m_pending.loadAcquire() == 0)
+            return false;
+
+        // a task queued before the lock was taken didn't wake anyone
+        if (this->steal(worker, task) || this->pop(worker, task))
+            return true;
+
+        this->m_waiting++;
+        this->m_idle.wait(&this->m_idleMutex);
+        this->m_waiting--;
+    }
+}
+
+void ParallelDirWalker::finish()
+{
+    if (this->m_pending.deref())
+        return;
+
+    // wake all sleeping workers, they exit now
+    QMutexLocker lock(&this->m_idleMutex);
+    this->m_idle.wakeAll();
+}
+
+void ParallelDirWalker::readDirectory(int worker, const Task &task, const QList<QRegExp> &wildcards)
+{
+#ifdef Q_OS_LINUX
+    const QByteArray &dir = task.dir;
+
+    // open the directory relative to its parent, the start directories and directories
+    // without an open parent relative to the root directory
+    int fd;
+    if (task.parent && task.parent->fd != -1)
+        fd = ::openat(task.parent->fd, task.name.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    else fd = ::openat(this->m_rootFd, dir.isEmpty() ? "." : dir.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd == -1)
+        return;
+
+    // symbolic links are followed, a link to one of its own parents is a loop and skipped (same as QDirIterator)
+    // the same directory reachable through different paths is listed under every path, independent of the worker order
+    struct stat dirstat;
+    bool skip = ::fstat(fd, &dirstat) == -1;
+
+    const DirectoryId id(dirstat.st_dev, dirstat.st_ino);
+    for (const Node *ancestor = task.parent.data(); ancestor && !skip; ancestor = ancestor->parent.data())
+        skip = ancestor->id == id;
+
+    if (skip)
+    {
+        ::close(fd);
+        return;
+    }
+
+    // the tasks of all subdirectories share this node, the directory stays open until the last one was opened
+    QSharedPointer<Node> node(new Node);
+    node->id = id;
+    node->parent = task.parent;
+    node->ptr_open = &this->m_openDirs;
+
+    // the node owns the descriptor from now on
+    if (this->m_openDirs.fetchAndAddAcquire(1) < MaxOpenDirectories)
+        node->fd = fd;
+    else (void) this->m_openDirs.deref();
+
+    Task subtask;
+    subtask.parent = node;
+
+    const QString dirKey = dir.isEmpty() ? QString() : QFile::decodeName(dir);
+    const QString dirName = dir.isEmpty() ? QString() : dirKey + '/';
+    QStringList *results = this->m_results.at(worker);
+
+    Directory record;
+    record.mtime = dirstat.st_mtim.tv_sec * Q_INT64_C(1000000000) + dirstat.st_mtim.tv_nsec;
+    record.inode = dirstat.st_ino;
+
+    // the directory didn't change since the previous walk, don't read it again
+    if (this->ptr_previous)
+    {
+        DirectoryState::const_iterator previous = this->ptr_previous->constFind(dirKey);
+
+        if (previous != this->ptr_previous->constEnd() &&
+            previous->mtime == record.mtime &&
+            previous->inode == record.inode)
+        {
+            if (node->fd == -1)
+                ::close(fd);
+
+            for (const QString &file : previous->files)
+                results->append(dirName + file);
+
+            for (const QByteArray &subdir : previous->subdirs)
+            {
+                subtask.dir = dir.isEmpty() ? subdir : dir + '/' + subdir;
+                subtask.name = subdir;
+                this->push(worker, subtask);
+            }
+
+            this->m_states.at(worker)->insert(dirKey, previous.value());
+            return;
+        }
+    }
+
+    // the mtime resolution of some filesystems is very coarse, a change right after the
+    // walk may not change the mtime at all, such directories are always read again
+    if (record.mtime > this->m_walkStarted - Q_INT64_C(2000000000))
+        record.mtime = -1;
+
+    alignas(8) char buf[32768];
+    long nread;
+
+    while ((nread = ::syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0)
+    {
+        for (long pos = 0; pos < nread; )
+        {
+            const LinuxDirent64 *entry = reinterpret_cast<const LinuxDirent64*>(buf + pos);
+            pos += entry->d_reclen;
+
+            const char *name = entry->d_name;
+
+            // skip '.', '..' and hidden entries
+            if (name[0] == '.')
+                continue;
+
+            int length = std::strlen(name);
+            unsigned char type = entry->d_type;
+
+            // the filesystem doesn't know the type or it is a symbolic link, ask the kernel
+            if (type == DT_UNKNOWN || type == DT_LNK)
+            {
+                struct stat target;
+                if (::fstatat(fd, name, &target, 0) == -1)
+                    continue; // broken link
+
+                if (S_ISDIR(target.st_mode))
+                    type = DT_DIR;
+                else if (S_ISREG(target.st_mode))
+                    type = DT_REG;
+                else continue;
+            }
+
+            if (type == DT_DIR)
+            {
+                QByteArray subdir(name, length);
+                subtask.dir = dir.isEmpty() ? subdir : dir + '/' + subdir;
+                subtask.name = subdir;
+                this->push(worker, subtask);
+                record.subdirs.append(subdir);
+            }
+
+            else if (type == DT_REG && this->matchesNameFilters(name, length, wildcards))
+            {
+                QString file = QFile::decodeName(QByteArray(name, length));
+                results->append(dirName + file);
+                record.files.append(file);
+            }
+        }
+    }
+
+    if (node->fd == -1)
+        ::close(fd);
+
+    this->m_states.at(worker)->insert(dirKey, record);
+    this->m_changed.at(worker)->append(dirKey);
+#else
+    Q_UNUSED(worker);
+    Q_UNUSED(task);
+    Q_UNUSED(wildcards);
+#endif
+}
+
+bool ParallelDirWalker::matchesNameFilters(const char *name, int length, const QList<QRegExp> &wildcards) const
+{
+    if (this->m_matchAll)
+        return true;
+
+    // compare the extension on the raw bytes first, no decoding required
+    for (int i = length - 1; i >= 0; i--)
+    {
+        if (name[i] == '.')
+        {
+            if (i + 1 < length && this->m_extensions.contains(QByteArray(name + i + 1, length - i - 1).toLower()))
+                return true;
+            break;
+        }
+    }
+
+    if (wildcards.isEmpty())
+        return false;
+
+    const QString filename = QFile::decodeName(QByteArray(name, length));
+    for (const QRegExp &wildcard : wildcards)
+    {
+        if (wildcard.exactMatch(filename))
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,178 @@
+/***************************************************************************
+ * ParallelDirWalker
+ *
+ * Multi-threaded directory tree walker, used as alternative backend
+ * of the FileSystemModel (see FileSystemModel::ParallelWalker).
+ *
+ *    ~ Linux only, other platforms should stay with QDirIterator
+ *
+ *
+ * Every directory is a task. Each worker thread has its own task queue,
+ * newly found subdirectories are pushed to the queue of the worker which
+ * found them. A worker without work steals tasks from the other queues,
+ * this keeps all threads busy even if the tree is very unbalanced. Idle
+ * workers sleep until new tasks are queued or the walk is finished.
+ *
+ * The tasks of all subdirectories share a node of their parent directory,
+ * which keeps the parent open (subdirectories are opened with openat(),
+ * the kernel doesn't resolve the whole path again) and links to its own
+ * parent. The chain of nodes is used to detect symbolic link loops.
+ *
+ * Directories are read using getdents64() and the d_type field of the
+ * directory entries. Files are matched against the name filters by their
+ * name only, a stat() is only required if the filesystem doesn't report
+ * the entry type (DT_UNKNOWN) or for symbolic links.
+ *
+ * The walker follows the same rules as the QDirIterator in the
+ * FileSystemModel:
+ *
+ *   × symbolic links are followed, loops are detected and skipped
+ *   × hidden files and directories are skipped
+ *   × name filters are case-insensitive wildcards and apply to files only
+ *
+ * The file list is NOT sorted, the FileSystemModel takes care of that.
+ *
+ *
+ * Incremental walks
+ *
+ *   The walker records the modification time, the inode and the contents
+ *   of every directory it reads (see 'state'). If such a state is passed
+ *   to the next walk, directories with the same mtime and inode are not
+ *   read again; their file and subdirectory lists are taken from the state.
+ *   Only one fstat() is required for every unchanged directory.
+ *
+ *   A directory mtime only changes if entries are added, removed or renamed
+ *   in that directory, files which are modified in place are not detected.
+ *
+ *   A walk can be limited to some subtrees of the root path, the library
+ *   watcher uses this to read only the directories which reported changes.
+ *
+ */
+
+#ifndef PARALLELDIRWALKER_HPP
+#define PARALLELDIRWALKER_HPP
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QRegExp>
+#include <QAtomicInt>
+
+class ParallelDirWalker
+{
+public:
+    ParallelDirWalker(const QString &rootPath, const QStringList &nameFilters, int threads = 0);
+    ~ParallelDirWalker();
+
+    // snapshot of a single directory
+    struct Directory {
+        qint64 mtime = 0;          // nanoseconds, -1 forces a re-read on the next walk
+        quint64 inode = 0;
+        QStringList files;         // names of the files which matched the name filters
+        QList<QByteArray> subdirs; // raw names of all subdirectories
+    };
+
+    // key: directory path relative to the root path, the root directory itself is an empty string
+    typedef QHash<QString, Directory> DirectoryState;
+
+    // checks if the walker is available on the current platform
+    static bool isSupported();
+
+    // state of a previous walk, unchanged directories are not read again
+    // the state must stay valid until 'walk' returns
+    void setPreviousState(const DirectoryState *state);
+
+    // walks the whole directory tree, blocks until all workers are finished
+    void walk();
+
+    // walks only the given subtrees (paths relative to the root path)
+    // the state and the file list contain nothing outside of this subtrees
+    void walk(const QList<QByteArray> &startDirs);
+
+    // returns all files which matched the name filters, paths are relative to the root path
+    QStringList files() const;
+
+    // returns the state of all directories seen during the last walk
+    DirectoryState state() const;
+
+    // returns all directories which were new or changed since the previous state
+    QStringList changedDirectories() const;
+
+private:
+    class Worker;
+    friend class Worker;
+
+    // (device, inode) of a directory
+    typedef QPair<quint64, quint64> DirectoryId;
+
+    // a directory which was read, shared by the tasks of all of its subdirectories
+    struct Node {
+        ~Node();
+
+        DirectoryId id;
+        int fd = -1;                // open until the last subdirectory was opened, -1 if too many are open
+        QSharedPointer<Node> parent;
+        QAtomicInt *ptr_open = nullptr;
+    };
+
+    struct Task {
+        QByteArray dir;              // relative directory path, an empty path is the root directory
+        QByteArray name;             // last component of [dir]
+        QSharedPointer<Node> parent; // all directories above [dir] on the way from the start directory
+    };
+
+    struct TaskQueue {
+        QMutex mutex;
+        QList<Task> tasks;
+    };
+
+    void push(int worker, const Task &task);
+    bool pop(int worker, Task &task);
+    bool steal(int worker, Task &task);
+
+    // blocks until a task is available, returns false if the walk is finished
+    bool wait(int worker, Task &task);
+
+    // the task is done AFTER all subdirectories were queued
+    void finish();
+
+    // QRegExp is not reentrant, every worker passes its own wildcard list
+    void readDirectory(int worker, const Task &task, const QList<QRegExp> &wildcards);
+
+    bool matchesNameFilters(const char *name, int length, const QList<QRegExp> &wildcards) const;
+
+    QByteArray m_root;
+    int m_threads;
+
+    // name filters, simple '*.ext' filters are compared on the raw bytes
+    bool m_matchAll;
+    QSet<QByteArray> m_extensions;
+    QStringList m_wildcards;
+
+    QList<TaskQueue*> m_queues;
+    // one entry per worker, no locking required
+    QList<QStringList*> m_results;
+    QList<DirectoryState*> m_states;
+    QList<QStringList*> m_changed;
+
+    QAtomicInt m_pending; // number of queued and running tasks
+
+    QMutex m_idleMutex;
+    QWaitCondition m_idle; // new tasks are queued or the walk is finished
+    int m_waiting = 0;     // number of sleeping workers, guarded by [m_idleMutex]
+
+    int m_rootFd = -1;
+    QAtomicInt m_openDirs; // directories kept open for their subdirectories
+
+    const DirectoryState *ptr_previous = nullptr;
+    qint64 m_walkStarted; // nanoseconds since epoch
+};
+
+#endif // PARALLELDIRWALKER_HPP
@@ -2,7 +2,8 @@
 
 #include <SearchPathGens/unicodewhitespacefixer.hpp>
 
-SearchKeys::SearchKeys(const QString &search_term)
+SearchKeys::SearchKeys(const QString &search_term, const QList<SearchPathGen*> &folding)
+    : m_folding(folding)
 {
     // extended search patterns
     if (search_term.contains('|'))
@@ -54,6 +55,18 @@ SearchKeys::SearchKeys(const QString &search_term)
                 this->m_extendedSearchPatterns.append(searchPattern);
             }
 
+            /// |min duration
+            else if (t.startsWith("min "))
+            {
+                this->m_minDuration = this->parseDuration(t.mid(4));
+            }
+
+            /// |max duration
+            else if (t.startsWith("max "))
+            {
+                this->m_maxDuration = this->parseDuration(t.mid(4));
+            }
+
             // ignore unknown pattern commands
         }
 
@@ -128,6 +141,21 @@ int SearchKeys::countKeys(SearchPatternType type) const
     return c;
 }
 
+int SearchKeys::minDuration() const
+{
+    return this->m_minDuration;
+}
+
+int SearchKeys::maxDuration() const
+{
+    return this->m_maxDuration;
+}
+
+bool SearchKeys::hasDurationFilter() const
+{
+    return this->m_minDuration != -1 || this->m_maxDuration != -1;
+}
+
 bool SearchKeys::empty() const
 {
     if (this->m_searchPattern.pattern().isEmpty())
@@ -141,7 +169,7 @@ bool SearchKeys::empty() const
     return true;
 }
 
-QRegExp SearchKeys::createSearchPattern(const QString &search_term)
+WildcardMatcher SearchKeys::createSearchPattern(const QString &search_term)
 {
     QString search_keys = search_term;
 
@@ -149,13 +177,21 @@ QRegExp SearchKeys::createSearchPattern(const QString &search_term)
     static const UnicodeWhitespaceFixer whitespacefixer;
     search_keys = whitespacefixer.processString(search_keys).at(0);
 
+    // canonical search mode, the search paths are folded the same way
+    for (const SearchPathGen *gen : this->m_folding)
+        search_keys = gen->fold(search_keys);
+
     // Create basic search keys (*search*term*)
     search_keys.replace(' ', '*');
     search_keys.insert(0, '*');
     search_keys.append('*');
 
     // Replace brackets, parentheses and slashes
-    search_keys.replace(QRegExp("[\\[\\]\\(\\)\\\\\\/]"), "*");
+    for (QChar &c : search_keys)
+    {
+        if (c == '[' || c == ']' || c == '(' || c == ')' || c == '\\' || c == '/')
+            c = '*';
+    }
 
     // Clean up search keys (remove occurrent following wildcards) [ eg: '***' becomes '*' ]
     for (int i = 0; i < search_keys.size(); i++)
@@ -173,12 +209,31 @@ QRegExp SearchKeys::createSearchPattern(const QString &search_term)
         }
     }
 
-    QRegExp search_pattern(search_keys, Qt::CaseInsensitive, QRegExp::WildcardUnix);
+    // the media store case-folded copies of their search paths, fold the pattern the same way
+    // and save the case-insensitive comparison on every character
+    WildcardMatcher search_pattern(search_keys.toCaseFolded(), Qt::CaseSensitive);
     search_keys.clear();
 
     return search_pattern;
 }
 
+int SearchKeys::parseDuration(const QString &duration)
+{
+    int seconds = 0;
+
+    for (const QString &part : duration.trimmed().split(':'))
+    {
+        bool ok = false;
+        int value = part.toInt(&ok);
+        if (!ok || value < 0)
+            return -1;
+
+        seconds = seconds * 60 + value;
+    }
+
+    return seconds;
+}
+
 bool SearchKeys::sort(const SearchPattern &p1, const SearchPattern &p2)
 {
     return (p1.type < p2.type);
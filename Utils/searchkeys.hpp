@@ -3,12 +3,15 @@
 
 #include <QString>
 #include <QList>
-#include <QRegExp>
+
+#include <Utils/wildcardmatcher.hpp>
+#include <Utils/searchpathgen.hpp>
 
 class SearchKeys
 {
 public:
-    SearchKeys(const QString &search_term);
+    // [folding]: the search terms are folded by these gens, see SearchPathGen::fold()
+    SearchKeys(const QString &search_term, const QList<SearchPathGen*> &folding = QList<SearchPathGen*>());
     ~SearchKeys();
 
     enum SearchPatternType {
@@ -23,7 +26,7 @@ public:
     };
 
     struct SearchPattern {
-        QRegExp searchPattern;
+        WildcardMatcher searchPattern;
         SearchPatternType type;
     };
 
@@ -33,15 +36,29 @@ public:
     bool containsKey(SearchPatternType) const;
     int countKeys(SearchPatternType) const;
 
+    // duration filters in seconds, -1 if not set
+    //   search term |min 1:30    <--- only tracks which are at least 90 seconds long
+    //   search term |max 300     <--- only tracks which are at most 5 minutes long
+    int minDuration() const;
+    int maxDuration() const;
+    bool hasDurationFilter() const;
+
     bool empty() const;
 
 private:
-    QRegExp createSearchPattern(const QString &search_term);
+    WildcardMatcher createSearchPattern(const QString &search_term);
+
+    // parses '90', '1:30' or '1:02:03' into seconds, returns -1 on error
+    static int parseDuration(const QString &duration);
 
     static bool sort(const SearchPattern &p1, const SearchPattern &p2);
 
+    QList<SearchPathGen*> m_folding;
     QList<SearchPattern> m_extendedSearchPatterns;
-    QRegExp m_searchPattern;
+    WildcardMatcher m_searchPattern;
+
+    int m_minDuration = -1;
+    int m_maxDuration = -1;
 };
 
 #endif // SEARCHKEYS_HPP
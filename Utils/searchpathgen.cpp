@@ -2,3 +2,9 @@
 
 // allow subclasses to be created as objects
 SearchPathGen::~SearchPathGen() { }
+
+// unknown gens always receive the whole path
+bool SearchPathGen::isPathSegmentSafe() const { return false; }
+
+// gens which don't know how to fold keep the string as it is
+QString SearchPathGen::fold(const QString &str) const { return str; }
@@ -24,6 +24,16 @@ public:
 
     // this function receives the original relative file path
     virtual QStringList processString(const QString&) const = 0;
+
+    // return true if every character is processed on its own (or at least never together with a '/')
+    // and the number of generated strings doesn't depend on the input, means:
+    //   processString(dir + file)[i] == processString(dir)[i] + processString(file)[i]
+    // the model than processes the directory part of a path only once for all files in that directory
+    virtual bool isPathSegmentSafe() const;
+
+    // canonical search mode: maps the string to the one form which stands for all strings this gen
+    // would generate, the search terms are folded the same way; returns the string unchanged by default
+    virtual QString fold(const QString&) const;
 };
 
 #endif // SEARCHPATHGEN_HPP
@@ -0,0 +1,138 @@
+#include "trigramindex.hpp"
+
+#include <QSet>
+
+#include <algorithm>
+#include <iterator>
+
+// a postings list which is that much longer than the current candidates isn't worth decoding,
+// it can only remove a few of them and the matcher has to verify them anyway
+static const int IntersectRatio = 8;
+// short lists are cheap to decode, always intersect them
+static const int IntersectMinCount = 1024;
+
+TrigramIndex::TrigramIndex()
+{
+}
+
+void TrigramIndex::clear()
+{
+    this->m_postings.clear();
+}
+
+bool TrigramIndex::isEmpty() const
+{
+    return this->m_postings.isEmpty();
+}
+
+void TrigramIndex::add(int id, const QStringList &strings)
+{
+    // a document is listed only once per trigram, no matter how often it contains it
+    QSet<quint64> trigrams;
+
+    for (const QString &str : strings)
+    {
+        for (int i = 0; i + 3 <= str.size(); i++)
+            trigrams.insert(trigram(str.constData() + i));
+    }
+
+    for (const quint64 t : trigrams)
+    {
+        Postings &postings = this->m_postings[t];
+
+        quint32 delta = quint32(id - postings.last);
+        while (delta >= 0x80)
+        {
+            postings.data.append(char((delta & 0x7F) | 0x80));
+            delta >>= 7;
+        }
+        postings.data.append(char(delta));
+
+        postings.last = id;
+        postings.count++;
+    }
+}
+
+bool TrigramIndex::candidates(const QStringList &tokens, QVector<int> *result) const
+{
+    result->clear();
+
+    QSet<quint64> trigrams;
+    for (const QString &token : tokens)
+    {
+        for (int i = 0; i + 3 <= token.size(); i++)
+            trigrams.insert(trigram(token.constData() + i));
+    }
+
+    if (trigrams.isEmpty())
+        return false;
+
+    QVector<const Postings*> lists;
+    lists.reserve(trigrams.size());
+
+    for (const quint64 t : trigrams)
+    {
+        QHash<quint64, Postings>::const_iterator it = this->m_postings.constFind(t);
+
+        // no document contains this trigram, nothing can match
+        if (it == this->m_postings.constEnd())
+            return true;
+
+        lists.append(&it.value());
+    }
+
+    // the shortest list limits the result, start with it and keep the working set small
+    std::sort(lists.begin(), lists.end(), [](const Postings *p1, const Postings *p2) {
+        return p1->count < p2->count;
+    });
+
+    decode(*lists.first(), result);
+
+    QVector<int> ids, intersection;
+    for (int i = 1; i < lists.size() && !result->isEmpty(); i++)
+    {
+        // the lists are sorted, all following lists are even longer
+        const int count = lists.at(i)->count;
+        if (count > IntersectMinCount && count / IntersectRatio > result->size())
+            break;
+
+        decode(*lists.at(i), &ids);
+
+        intersection.clear();
+        std::set_intersection(result->constBegin(), result->constEnd(),
+                              ids.constBegin(), ids.constEnd(),
+                              std::back_inserter(intersection));
+        result->swap(intersection);
+    }
+
+    return true;
+}
+
+quint64 TrigramIndex::trigram(const QChar *c)
+{
+    return (quint64(c[0].unicode()) << 32) | (quint64(c[1].unicode()) << 16) | quint64(c[2].unicode());
+}
+
+void TrigramIndex::decode(const Postings &postings, QVector<int> *ids)
+{
+    ids->clear();
+    ids->reserve(postings.count);
+
+    const uchar *data = reinterpret_cast<const uchar*>(postings.data.constData());
+    const uchar *end = data + postings.data.size();
+
+    int id = -1;
+    while (data < end)
+    {
+        quint32 delta = 0;
+        int shift = 0;
+
+        do {
+            delta |= quint32(*data & 0x7F) << shift;
+            shift += 7;
+        } while (*data++ & 0x80);
+
+        id += int(delta);
+        ids->append(id);
+    }
+}
@@ -0,0 +1,63 @@
+/***************************************************************************
+ * TrigramIndex
+ *
+ * Inverted index of all 3-character substrings (trigrams) of a list of
+ * documents, used to find the candidates of a wildcard search without
+ * looking at every document.
+ *
+ * Every document is a list of strings (the search paths of a media) and
+ * is identified by its position in the list it was built from. A document
+ * contains a trigram if any of its strings contains it.
+ *
+ * The postings list of a trigram stores the ascending document ids as
+ * variable-length deltas (7 bits per byte), most deltas fit into a single
+ * byte. Lists are intersected starting with the shortest one, lists which
+ * are much longer than the remaining candidates are not decoded at all;
+ * common trigrams would cost O(library) for almost no effect.
+ *
+ * The index doesn't know anything about case folding, the strings and
+ * the query tokens must be folded the same way before they are passed in.
+ *
+ *    ~ candidates are a superset of the matches, always verify them
+ *    ~ tokens shorter than 3 characters can't be looked up
+ *
+ */
+
+#ifndef TRIGRAMINDEX_HPP
+#define TRIGRAMINDEX_HPP
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class TrigramIndex
+{
+public:
+    TrigramIndex();
+
+    void clear();
+    bool isEmpty() const;
+
+    // appends a document, ids must be added in ascending order
+    void add(int id, const QStringList &strings);
+
+    // ascending ids of the documents which may contain every trigram of every token,
+    // returns false if none of the tokens is long enough to use the index (all documents are candidates)
+    bool candidates(const QStringList &tokens, QVector<int> *result) const;
+
+private:
+    struct Postings {
+        QByteArray data; // delta encoded ids
+        int last = -1;   // last id, the next delta is relative to it
+        int count = 0;
+    };
+
+    static quint64 trigram(const QChar *c);
+    static void decode(const Postings &postings, QVector<int> *ids);
+
+    QHash<quint64, Postings> m_postings;
+};
+
+#endif // TRIGRAMINDEX_HPP
@@ -0,0 +1,148 @@
+#include "wildcardmatcher.hpp"
+
+WildcardMatcher::WildcardMatcher()
+    : m_cs(Qt::CaseInsensitive)
+{
+}
+
+WildcardMatcher::WildcardMatcher(const QString &pattern, Qt::CaseSensitivity cs)
+    : m_pattern(pattern),
+      m_cs(cs)
+{
+    this->m_anchoredStart = !pattern.startsWith('*');
+    this->m_anchoredEnd = !pattern.endsWith('*');
+
+    for (const QString &text : pattern.split('*', QString::SkipEmptyParts))
+    {
+        Token token;
+        token.text = text;
+        token.wildcards = text.contains('?');
+        if (!token.wildcards)
+            token.matcher = QStringMatcher(text, cs);
+
+        this->m_tokens.append(token);
+    }
+
+    // a long token is less likely to be found, check it first
+    for (int i = 0; i < this->m_tokens.size(); i++)
+    {
+        const Token &token = this->m_tokens.at(i);
+        if (!token.wildcards && (this->m_rarest == -1 || token.text.size() > this->m_tokens.at(this->m_rarest).text.size()))
+            this->m_rarest = i;
+    }
+}
+
+const QString &WildcardMatcher::pattern() const
+{
+    return this->m_pattern;
+}
+
+QStringList WildcardMatcher::literals() const
+{
+    QStringList literals;
+
+    for (const Token &token : this->m_tokens)
+    {
+        if (token.wildcards)
+            literals.append(token.text.split('?', QString::SkipEmptyParts));
+        else
+            literals.append(token.text);
+    }
+
+    return literals;
+}
+
+bool WildcardMatcher::exactMatch(const QString &str) const
+{
+    return this->match(str, nullptr);
+}
+
+bool WildcardMatcher::match(const QString &str, QVector<Match> *matches) const
+{
+    if (matches)
+        matches->clear();
+
+    // '' matches only the empty string, '*' matches everything
+    if (this->m_tokens.isEmpty())
+        return !this->m_anchoredStart || str.isEmpty();
+
+    // quick reject, most strings don't contain the longest token at all
+    if (this->m_tokens.size() > 1 && this->m_rarest != -1 &&
+        this->m_tokens.at(this->m_rarest).matcher.indexIn(str) == -1)
+        return false;
+
+    int pos = 0;
+    const int last = this->m_tokens.size() - 1;
+
+    for (int i = 0; i <= last; i++)
+    {
+        const Token &token = this->m_tokens.at(i);
+
+        // the last token must end with the string, the first possible match is the only one which counts
+        if (i == last && this->m_anchoredEnd)
+        {
+            const int end_pos = str.size() - token.text.size();
+            if (end_pos < pos || (i == 0 && this->m_anchoredStart && end_pos != 0))
+                return false;
+            if (!this->matchesAt(token, str, end_pos))
+                return false;
+            if (matches)
+                matches->append({end_pos, token.text.size()});
+            return true;
+        }
+
+        if (i == 0 && this->m_anchoredStart)
+        {
+            if (!this->matchesAt(token, str, 0))
+                return false;
+            if (matches)
+                matches->append({0, token.text.size()});
+            pos = token.text.size();
+            continue;
+        }
+
+        // leftmost match, leaves the most room for the following tokens
+        const int found = this->indexOf(token, str, pos);
+        if (found == -1)
+            return false;
+        if (matches)
+            matches->append({found, token.text.size()});
+        pos = found + token.text.size();
+    }
+
+    return true;
+}
+
+int WildcardMatcher::indexOf(const Token &token, const QString &str, int from) const
+{
+    if (!token.wildcards)
+        return token.matcher.indexIn(str, from);
+
+    for (int pos = from; pos + token.text.size() <= str.size(); pos++)
+    {
+        if (this->matchesAt(token, str, pos))
+            return pos;
+    }
+
+    return -1;
+}
+
+bool WildcardMatcher::matchesAt(const Token &token, const QString &str, int pos) const
+{
+    if (pos < 0 || pos + token.text.size() > str.size())
+        return false;
+
+    const QChar *p = token.text.constData();
+    const QChar *s = str.constData() + pos;
+
+    for (int i = 0; i < token.text.size(); i++)
+    {
+        if (p[i] == '?')
+            continue;
+
+        if (this->m_cs == Qt::CaseSensitive ? p[i] != s[i] : p[i].toCaseFolded() != s[i].toCaseFolded())
+            return false;
+    }
+
+    return true;
+}
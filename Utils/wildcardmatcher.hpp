@@ -0,0 +1,66 @@
+#ifndef WILDCARDMATCHER_HPP
+#define WILDCARDMATCHER_HPP
+
+#include <QString>
+#include <QStringList>
+#include <QStringMatcher>
+#include <QList>
+#include <QVector>
+
+// matches unix wildcard patterns of the form '*token*token*' without a regular expression
+//
+//  × '*' matches any number of characters, the tokens must appear in order
+//  × '?' matches any single character
+//  × no character classes, the search keys never contain them
+//
+// every token is a precompiled substring search (Boyer-Moore), the longest token
+// is looked for first to reject most strings as early as possible
+//
+// drop-in replacement for QRegExp(pattern, cs, QRegExp::WildcardUnix).exactMatch()
+
+class WildcardMatcher
+{
+public:
+    WildcardMatcher();
+    WildcardMatcher(const QString &pattern, Qt::CaseSensitivity cs = Qt::CaseInsensitive);
+
+    const QString &pattern() const;
+
+    // the literal parts of the pattern (no wildcards), every match contains all of them
+    QStringList literals() const;
+
+    // true if the whole string matches the pattern
+    bool exactMatch(const QString &str) const;
+
+    // position and length of a token in the matched string
+    struct Match {
+        int pos;
+        int length;
+    };
+
+    // same as exactMatch(), stores where every token was found (leftmost match)
+    bool match(const QString &str, QVector<Match> *matches) const;
+
+private:
+    struct Token {
+        QString text;
+        QStringMatcher matcher;
+        bool wildcards = false; // contains '?', the matcher can't be used
+    };
+
+    // position of the next occurrence of the token at or after [from], -1 if there is none
+    int indexOf(const Token &token, const QString &str, int from) const;
+
+    // checks if the token matches the string at [pos]
+    bool matchesAt(const Token &token, const QString &str, int pos) const;
+
+    QString m_pattern;
+    Qt::CaseSensitivity m_cs;
+
+    QList<Token> m_tokens;
+    bool m_anchoredStart = true; // pattern doesn't start with '*'
+    bool m_anchoredEnd = true;   // pattern doesn't end with '*'
+    int m_rarest = -1;           // longest token without '?'
+};
+
+#endif // WILDCARDMATCHER_HPP
@@ -0,0 +1,87 @@
+#include "xxhash64.hpp"
+
+#include <QtEndian>
+
+static const quint64 Prime64_1 = Q_UINT64_C(11400714785074694791);
+static const quint64 Prime64_2 = Q_UINT64_C(14029467366897019727);
+static const quint64 Prime64_3 = Q_UINT64_C(1609587929392839161);
+static const quint64 Prime64_4 = Q_UINT64_C(9650029242287828579);
+static const quint64 Prime64_5 = Q_UINT64_C(2870177450012600261);
+
+static inline quint64 rotl64(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 xxh64Round(quint64 acc, quint64 input)
+{
+    acc += input * Prime64_2;
+    acc = rotl64(acc, 31);
+    return acc * Prime64_1;
+}
+
+static inline quint64 xxh64MergeRound(quint64 acc, quint64 val)
+{
+    acc ^= xxh64Round(0, val);
+    return acc * Prime64_1 + Prime64_4;
+}
+
+quint64 xxh64(const uchar *data, quint64 len, quint64 seed)
+{
+    const uchar *p = data;
+    const uchar *end = data + len;
+    quint64 h;
+
+    if (len >= 32)
+    {
+        quint64 v1 = seed + Prime64_1 + Prime64_2;
+        quint64 v2 = seed + Prime64_2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime64_1;
+
+        do {
+            v1 = xxh64Round(v1, qFromLittleEndian<quint64>(p)); p += 8;
+            v2 = xxh64Round(v2, qFromLittleEndian<quint64>(p)); p += 8;
+            v3 = xxh64Round(v3, qFromLittleEndian<quint64>(p)); p += 8;
+            v4 = xxh64Round(v4, qFromLittleEndian<quint64>(p)); p += 8;
+        } while (p + 32 <= end);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64MergeRound(h, v1);
+        h = xxh64MergeRound(h, v2);
+        h = xxh64MergeRound(h, v3);
+        h = xxh64MergeRound(h, v4);
+    }
+
+    else h = seed + Prime64_5;
+
+    h += len;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= xxh64Round(0, qFromLittleEndian<quint64>(p));
+        h = rotl64(h, 27) * Prime64_1 + Prime64_4;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= quint64(qFromLittleEndian<quint32>(p)) * Prime64_1;
+        h = rotl64(h, 23) * Prime64_2 + Prime64_3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+    {
+        h ^= (*p) * Prime64_5;
+        h = rotl64(h, 11) * Prime64_1;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= Prime64_2;
+    h ^= h >> 29;
+    h *= Prime64_3;
+    h ^= h >> 32;
+
+    return h;
+}
@@ -0,0 +1,13 @@
+#ifndef XXHASH64_HPP
+#define XXHASH64_HPP
+
+#include <QtGlobal>
+
+// xxHash64, see https://github.com/Cyan4973/xxHash
+//
+// fast non-cryptographic hash, used for the keys of the MediaCache
+// and the checksum of the library snapshot
+
+quint64 xxh64(const uchar *data, quint64 len, quint64 seed = 0);
+
+#endif // XXHASH64_HPP
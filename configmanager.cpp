@@ -140,6 +140,10 @@ void ConfigManager::loadDefaultSettings()
     BoostPtreePut(Key::LibVideoFormats);
     BoostPtreePut(Key::LibModuleFormats);
     BoostPtreePut(Key::LibPrefixDeletionPatterns);
+    BoostPtreePut(Key::LibFilesystemWatcher);
+    BoostPtreePut(Key::LibLazyTags);
+    BoostPtreePut(Key::LibAudioProperties);
+    BoostPtreePut(Key::LibCanonicalSearch);
 
     BoostPtreePut(Key::PlayerAudio);
     BoostPtreePut(Key::PlayerVideo);
@@ -185,6 +189,10 @@ void ConfigManager::loadSettings()
     this->addIfMissing(Key::LibVideoFormats);
     this->addIfMissing(Key::LibModuleFormats);
     this->addIfMissing(Key::LibPrefixDeletionPatterns);
+    this->addIfMissing(Key::LibFilesystemWatcher);
+    this->addIfMissing(Key::LibLazyTags);
+    this->addIfMissing(Key::LibAudioProperties);
+    this->addIfMissing(Key::LibCanonicalSearch);
 
     this->addIfMissing(Key::PlayerAudio);
     this->addIfMissing(Key::PlayerVideo);
@@ -227,6 +235,10 @@ std::string ConfigManager::keyStr(Key key)
         case Key::LibVideoFormats: return "library.videoformats"; break;
         case Key::LibModuleFormats: return "library.moduleformats"; break;
         case Key::LibPrefixDeletionPatterns: return "library.prefixdeletionpatterns"; break;
+        case Key::LibFilesystemWatcher: return "library.filesystemwatcher"; break;
+        case Key::LibLazyTags: return "library.lazytags"; break;
+        case Key::LibAudioProperties: return "library.audioproperties"; break;
+        case Key::LibCanonicalSearch: return "library.canonicalsearch"; break;
 
         case Key::PlayerAudio: return "player.audioplayer"; break;
         case Key::PlayerVideo: return "player.videoplayer"; break;
@@ -264,6 +276,10 @@ std::string ConfigManager::keyDefaultValue(Key key)
         case Key::LibVideoFormats: return "mp4, h264, h263, ts, m2ts, mov, ogm, avi, bk2, bnk, mkv, wmv, rv"; break;
         case Key::LibModuleFormats: return "xm, it, mod, med, sid, s3m"; break;
         case Key::LibPrefixDeletionPatterns: return "Music/;Video/;Videos/"; break;
+        case Key::LibFilesystemWatcher: return "true"; break;
+        case Key::LibLazyTags: return "false"; break;
+        case Key::LibAudioProperties: return "false"; break;
+        case Key::LibCanonicalSearch: return "false"; break;
 
         case Key::PlayerAudio: return "mplayer -novideo -really-quiet %f"; break;
         case Key::PlayerVideo: return "mplayer -fs -really-quiet %f"; break;
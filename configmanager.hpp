@@ -44,6 +44,10 @@ public:
         LibVideoFormats,
         LibModuleFormats,
         LibPrefixDeletionPatterns,
+        LibFilesystemWatcher,
+        LibLazyTags,
+        LibAudioProperties,
+        LibCanonicalSearch,
 
         PlayerAudio,
         PlayerVideo,
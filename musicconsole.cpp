@@ -13,6 +13,9 @@
 #include <Sys/mediaplayercontroller.hpp>
 #include <Sys/historymanager.hpp>
 #include <Sys/mediacache.hpp>
+#include <Sys/librarywatcher.hpp>
+#include <Sys/libraryscanner.hpp>
+#include <Sys/tagsloader.hpp>
 
 static const UnicodeWhitespaceFixer usf;
 static const QChar space(0x20);
@@ -40,14 +43,23 @@ MusicConsole::MusicConsole(QObject *parent)
     this->m_config = new ConfigManager();
 
     // create the media cache
+    // the cached search paths depend on the search mode, canonical search has its own cache
+    const bool canonicalSearch = this->m_config->boolean(ConfigManager::Key::LibCanonicalSearch);
     MediaCache::createInstance(
         this->m_config->configDir() +
         QDir::separator() +
-        "cache");
+        (canonicalSearch ? "cache-canonical" : "cache"));
 
     // create the media library model
     this->m_media = new MediaLibraryModel(CONFIGVAL(LibRootPath));
     this->m_media->setPrefixDeletionPatterns(CONFIGVAL(LibPrefixDeletionPatterns));
+    this->m_media->setSnapshotFile(
+        this->m_config->configDir() +
+        QDir::separator() +
+        "library");
+    this->m_media->setLazyTags(this->m_config->boolean(ConfigManager::Key::LibLazyTags));
+    this->m_media->setAudioProperties(this->m_config->boolean(ConfigManager::Key::LibAudioProperties));
+    this->m_media->setCanonicalSearch(canonicalSearch);
 
     // create the user filters
     this->m_media->setNameFilters(MediaLibraryModel::Audio, this->createNameFilters(CONFIGVAL(LibAudioFormats)));
@@ -134,6 +146,11 @@ MusicConsole::MusicConsole(QObject *parent)
 MusicConsole::~MusicConsole()
 {
     delete this->m_config;
+
+    // the watcher, the scanner and the tags loader are using the media library model, stop them first
+    delete this->m_watcher;
+    delete this->m_scanner;
+    delete this->m_tagsLoader;
     delete this->m_media;
 
     for (Command *c : this->m_commands)
@@ -168,8 +185,38 @@ void MusicConsole::executeCmd() const
 void MusicConsole::run()
 {
     // build media list
+    // restore the library of the last session if possible and compare it with the filesystem in the background
+    // otherwise scan the filesystem in the background, the library can be used while the scan is running
     this->installSearchPathGens();
-    this->m_media->iterateFilesystem();
+    if (this->m_media->loadSnapshot())
+    {
+        this->m_scanner = new LibraryScanner(this->m_media, LibraryScanner::Validate);
+    }
+
+    else if (ParallelDirWalker::isSupported())
+    {
+        std::cout << "Scanning your library in the background, see '" << qUtf8Printable(CONFIGVAL(CmdStatistics)) << "' for the progress.\n" << std::endl;
+        this->m_scanner = new LibraryScanner(this->m_media, LibraryScanner::FullScan);
+    }
+
+    else this->m_media->iterateFilesystem();
+
+    if (this->m_scanner)
+        this->m_scanner->start();
+
+    // keep the library up to date in the background
+    if (this->m_config->boolean(ConfigManager::Key::LibFilesystemWatcher) && LibraryWatcher::isSupported())
+    {
+        this->m_watcher = new LibraryWatcher(this->m_media);
+        this->m_watcher->start(QThread::LowPriority);
+    }
+
+    // read the tags and audio properties of new media in the background
+    if (this->m_media->lazyTags() || this->m_media->audioProperties())
+    {
+        this->m_tagsLoader = new TagsLoader(this->m_media);
+        this->m_tagsLoader->start(QThread::LowestPriority);
+    }
 
     // command container; split happens at '&&', makes it possible to execute multiple commands with a one-liner
     QList<ConsoleCommand> commands;
@@ -179,6 +226,9 @@ void MusicConsole::run()
     {
         this->userInput(commands);
 
+        // apply the changes of the library watcher before any command uses the media list
+        (void) this->m_media->applyPendingUpdates();
+
         bool command_matched = false;
         for (const ConsoleCommand &cc : commands)
         {
@@ -245,6 +295,19 @@ void MusicConsole::installSearchPathGens()
 
 void MusicConsole::prepareToQuit()
 {
+    // don't wait for a running scan, the next session continues from the last snapshot
+    this->m_media->cancelScans();
+
+    if (this->m_watcher)
+        this->m_watcher->stop();
+    if (this->m_tagsLoader)
+        this->m_tagsLoader->stop();
+    if (this->m_scanner)
+        this->m_scanner->wait();
+
+    // store the current state of the library for a fast startup next time
+    (void) this->m_media->applyPendingUpdates();
+    (void) this->m_media->saveSnapshot();
 }
 
 void MusicConsole::userInput(QList<ConsoleCommand> &commands)
@@ -9,6 +9,10 @@
 
 #include <Sys/command.hpp>
 
+class LibraryWatcher;
+class LibraryScanner;
+class TagsLoader;
+
 class MusicConsole : public QThread
 {
     Q_OBJECT
@@ -32,6 +36,9 @@ private:
     int m_statusCode;
 
     MediaLibraryModel *m_media = nullptr;
+    LibraryWatcher *m_watcher = nullptr;
+    LibraryScanner *m_scanner = nullptr;
+    TagsLoader *m_tagsLoader = nullptr;
 
     QList<Command*> m_commands;
 